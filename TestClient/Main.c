@@ -166,13 +166,33 @@ FILE* getFile(const char* peerId) {
 	return NULL;
 }
 
-// Resize the buffer parameters and move data if needed
-void resizeBuffer(int read) {
+// Return 1 if data begins with a complete FLV tag (after the FLV header if present)
+int hasCompleteTag(const char* data, int size) {
+	unsigned int bodySize = 0;
+
+	if (size >= 3 && memcmp(data, "FLV", 3) == 0) {
+		if (size < 13)
+			return 0;
+		data += 13;
+		size -= 13;
+	}
+	if (size < 11)
+		return 0;
+	bodySize = ((unsigned char)data[1] << 16) | ((unsigned char)data[2] << 8) | (unsigned char)data[3];
+	return size >= (int)(11 + bodySize + 4);
+}
+
+// Resize the buffer parameters and move data if needed (size is the number of bytes in the buffer)
+void resizeBuffer(int read, int size) {
 	int ratio = 0;
 
-	if (read == 0) { // nothing read, buffer too short
+	if (read == 0) { // nothing written, the data is kept for the next call
+		cursor = size;
+		if (hasCompleteTag(buf, size))
+			return; // the publication queue is full, we will try again later
+		if (cursor < bufferSize)
+			return; // the tag is not complete, we will read further data
 		onLog(0, 7, __FILE__, __LINE__, "Buffer too short, increasing...");
-		cursor += (bufferSize - cursor);
 		bufferSize += MIN_BUFFER_SIZE;
 		if (bufferSize > MAX_BUFFER_SIZE) {
 			endOfWrite = terminating = 1; // Error encountered
@@ -180,9 +200,9 @@ void resizeBuffer(int read) {
 		}
 		return;
 	}
-	// Something has been read, we need to move the remaining data
-	cursor = bufferSize - read;
-	memcpy(buf, buf + read, cursor); // Move remaining data to the start of the buffer
+	// Something has been written, we need to move the remaining data
+	cursor = size - read;
+	memmove(buf, buf + read, cursor); // Move remaining data to the start of the buffer
 
 	// Resize the buffer to keep max remaining data + MIN_BUFFER_SIZE
 	ratio = ((bufferSize - cursor) / MIN_BUFFER_SIZE);
@@ -242,26 +262,31 @@ void onManage() {
 	// Write
 	else if (pInFile && (_option == WRITE || _option == P2P_WRITE) && !endOfWrite) {
 
-		// First we read the file
-		towrite = fread(buf + cursor, sizeof(char), bufferSize - cursor, pInFile) + cursor;
-		if (ferror(pInFile) > 0) {
-			endOfWrite = terminating = 1; // Error encountered
-			onLog(0, 3, __FILE__, __LINE__, "Error while reading the input file, closing...");
+		// First we read the file (if the end is not reached)
+		towrite = cursor;
+		if (!feof(pInFile)) {
+			towrite += fread(buf + cursor, sizeof(char), bufferSize - cursor, pInFile);
+			if (ferror(pInFile) > 0) {
+				endOfWrite = terminating = 1; // Error encountered
+				onLog(0, 3, __FILE__, __LINE__, "Error while reading the input file, closing...");
+				return;
+			}
+		}
+
+		// 0 means that the publication queue is full or that the tag is not complete, data is kept
+		if ((read = RTMFP_Write(context, buf, towrite)) < 0) {
+			terminating = 1; // Error encountered
 			return;
 		}
-		else if (feof(pInFile) > 0) {
-			onLog(0, 5, __FILE__, __LINE__, "End of file reached, we send last data and unpublish");
+		resizeBuffer(read, towrite);
+
+		// Unpublish only when all the tags of the file are written
+		if (!endOfWrite && feof(pInFile) > 0 && !hasCompleteTag(buf, cursor)) {
+			onLog(0, 5, __FILE__, __LINE__, "End of file reached, last data sent, we unpublish");
 			endOfWrite = 1;
-			RTMFP_Write(context, buf, towrite);
 			if (_option == WRITE)
 				RTMFP_ClosePublication(context, publication);
-			return;
 		}
-
-		if ((read = RTMFP_Write(context, buf, towrite)) < 0)
-			terminating = 1; // Error encountered
-		else if (!endOfWrite)
-			resizeBuffer(read);
 	}
 }
 
@@ -0,0 +1,131 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**************************************************
+CodecBench measures the packets/s of the RTMFP codec
+(CRC + AES-128-CBC) for encoding and decoding, and
+compares it with the previous implementation (key
+schedule for each packet and separate CRC pass)
+Usage: make bench
+*/
+
+#include "RTMFP.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+using namespace Mona;
+
+#define BENCH_PACKETS	200000
+
+// Previous implementation of the codec, used as reference
+class LegacyEngine : public virtual Object {
+public:
+	LegacyEngine(const UInt8* key, RTMFPEngine::Direction direction) : _direction(direction) {
+		memcpy(_key, key, RTMFP_KEY_SIZE);
+		EVP_CIPHER_CTX_init(&_context);
+	}
+	virtual ~LegacyEngine() { EVP_CIPHER_CTX_cleanup(&_context); }
+
+	bool process(UInt8* data, int size) {
+		if (_direction == RTMFPEngine::ENCRYPT) {
+			BinaryReader reader(data + 2, size - 2);
+			BinaryWriter(data, 2).write16(Crypto::ComputeCRC(reader));
+		}
+		int newSize(size);
+		static const UInt8 IV[RTMFP_KEY_SIZE] = { 0 };
+		EVP_CipherInit_ex(&_context, EVP_aes_128_cbc(), NULL, _key, IV, _direction);
+		EVP_CipherUpdate(&_context, data, &newSize, data, size);
+		if (_direction == RTMFPEngine::DECRYPT) {
+			BinaryReader reader(data, size);
+			UInt16 crc(reader.read16());
+			return (Crypto::ComputeCRC(reader) == crc);
+		}
+		return true;
+	}
+
+private:
+	RTMFPEngine::Direction	_direction;
+	UInt8					_key[RTMFP_KEY_SIZE];
+	EVP_CIPHER_CTX			_context;
+};
+
+template<typename EngineType>
+static double Run(EngineType& encoder, EngineType& decoder, UInt8* packets, int size, bool& valid) {
+	auto start = chrono::steady_clock::now();
+	for (UInt32 i = 0; i < BENCH_PACKETS; ++i) {
+		UInt8* data = packets + (i % 64) * RTMFP_MAX_PACKET_SIZE;
+		encoder.process(data, size);
+		if (!decoder.process(data, size))
+			valid = false;
+	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	return BENCH_PACKETS / seconds;
+}
+
+int main() {
+	static const int Sizes[] = { 64, 256, RTMFP_MAX_PACKET_SIZE - 8 }; // (multiple of 16, 4 bytes of header are not encrypted)
+	static UInt8 Packets[64 * RTMFP_MAX_PACKET_SIZE];
+	srand(1);
+	for (UInt8& byte : Packets)
+		byte = (UInt8)rand();
+
+	// Check that the CRC is the same as Mona::Crypto::ComputeCRC for even and odd sizes
+	for (UInt32 size = 0; size < RTMFP_MAX_PACKET_SIZE; ++size) {
+		BinaryReader reader(Packets, size);
+		if (RTMFPEngine::ComputeCRC(Packets, size) != Crypto::ComputeCRC(reader)) {
+			printf("CRC mismatch for size %u\n", size);
+			return 1;
+		}
+	}
+
+	RTMFPEngine encoder(RTMFP_DEFAULT_KEY, RTMFPEngine::ENCRYPT), decoder(RTMFP_DEFAULT_KEY, RTMFPEngine::DECRYPT);
+	LegacyEngine legacyEncoder(RTMFP_DEFAULT_KEY, RTMFPEngine::ENCRYPT), legacyDecoder(RTMFP_DEFAULT_KEY, RTMFPEngine::DECRYPT);
+
+	// Check that the packets encoded by one implementation are decoded by the other one
+	UInt8* data = Packets;
+	int size = RTMFP_MAX_PACKET_SIZE - 8;
+	encoder.process(data, size);
+	if (!legacyDecoder.process(data, size)) {
+		printf("Legacy decoder rejects the packet\n");
+		return 1;
+	}
+	legacyEncoder.process(data, size);
+	if (!decoder.process(data, size)) {
+		printf("Decoder rejects the packet\n");
+		return 1;
+	}
+
+	bool valid(true);
+	printf("%-8s %16s %16s %8s\n", "size", "legacy (pkt/s)", "fused (pkt/s)", "gain");
+	for (int size : Sizes) {
+		double legacy = Run(legacyEncoder, legacyDecoder, Packets, size, valid);
+		double fused = Run(encoder, decoder, Packets, size, valid);
+		printf("%-8d %16.0f %16.0f %7.2fx\n", size, legacy, fused, fused / legacy);
+	}
+	if (!valid) {
+		printf("CRC error during the benchmark\n");
+		return 1;
+	}
+	return 0;
+}
@@ -24,6 +24,7 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "Mona/Mona.h"
 #include "AMF.h"
 #include "DataWriter.h"
+#include "ObjectPool.h"
 #include <map>
 #include <vector>
 
@@ -52,6 +53,10 @@ public:
 	void   writeNull();
 	Mona::UInt64 writeDate(const Mona::Date& date);
 	Mona::UInt64 writeBytes(const Mona::UInt8* data,Mona::UInt32 size);
+
+	// Allocated by RTMFPMessageBuffered for each message sent
+	static void*	operator new(std::size_t size) { return ObjectPool<AMFWriter>::Allocate(size); }
+	static void		operator delete(void* p, std::size_t size) { ObjectPool<AMFWriter>::Release(p, size); }
 	
 	bool				amf0;
 
@@ -23,6 +23,9 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "Mona/Mona.h"
 #include "Mona/PacketWriter.h"
+#include "CongestionController.h"
+#include "RTTEstimator.h"
+#include "TimerWheel.h"
 
 class RTMFPWriter;
 class BandWriter : public virtual Mona::Object {
@@ -40,6 +43,21 @@ public:
 	virtual Mona::UInt32					availableToWrite()=0;
 	virtual Mona::BinaryWriter&				writeMessage(Mona::UInt8 type,Mona::UInt16 length,RTMFPWriter* pWriter=NULL)=0;
 	virtual void							flush()=0;
+	// Return the congestion controller of the connection (window and pacing of new messages)
+	virtual CongestionController&			congestion() = 0;
+	// Return true if a writer can send now a new message of this class (see WriterScheduler)
+	virtual bool							canSend(Mona::UInt8 priority) = 0;
+	// Return the round-trip time estimator of the connection (retransmission timeout of the writers)
+	virtual const RTTEstimator&				rtt() = 0;
+	// Count the bytes of a media message abandoned because its lifetime has expired
+	virtual void							onExpired(Mona::UInt32 size) = 0;
+	// Return the timer wheel of the session (retransmission timeouts of the writers, delayed acknowledgments of the flows)
+	virtual TimerWheel&						timers() = 0;
+	// Ask to send the new messages of the writers and the current packet at the end of the cycle (manage or reception),
+	// the messages written meanwhile by the other writers complete the packet
+	virtual void							wakeUp() = 0;
+	// Same as wakeUp() for a writer which has finished to write, counts the packet that an immediate flush would have sent (see flushesDeferred)
+	virtual void							flushLater() = 0;
 	//virtual Mona::UInt16					ping() const = 0;
 	virtual const std::string&				name() = 0;
 	virtual bool							connected() = 0;	
@@ -0,0 +1,93 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Mona/Mona.h"
+#include "Mona/Startable.h"
+#include "Mona/PoolBuffer.h"
+#include "Mona/SocketAddress.h"
+#include "RTMFPSender.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#define RTMFP_BATCH_SIZE		32 // maximum number of datagrams received or sent by one system call
+#define RTMFP_RECEIVE_SIZE		2048 // size of each receiving buffer (larger than RTMFP_MAX_PACKET_SIZE to detect truncated packets)
+#define RTMFP_BATCH_TIMEOUT		100 // timeout of the receiving poll (in msec), used to check the stop request
+
+namespace BatchSocketEvents {
+	struct OnPacket : Mona::Event<void(Mona::PoolBuffer&, const Mona::SocketAddress&)> {}; // called by the receiving thread for each datagram
+	struct OnBatchEnd : Mona::Event<void()> {}; // called by the receiving thread after each batch of datagrams
+	struct OnError : Mona::Event<void(const Mona::Exception&)> {};
+};
+
+/**************************************************
+BatchSocket is a UDP socket (IPv4 and IPv6) which
+receives the datagrams by batches with recvmmsg in
+its own thread, and sends the packets queued by
+the connections with sendmmsg when flush() is called
+Only available on Linux (open() fails otherwise)
+*/
+class BatchSocket : public virtual Mona::Object, private Mona::Startable,
+	public BatchSocketEvents::OnPacket,
+	public BatchSocketEvents::OnBatchEnd,
+	public BatchSocketEvents::OnError {
+public:
+	BatchSocket(const Mona::PoolBuffers& poolBuffers);
+	virtual ~BatchSocket();
+
+	// Create the socket and start the receiving thread
+	bool					open(Mona::Exception& ex);
+
+	// Stop the receiving thread and close the socket
+	void					close();
+
+	// Return the local port of the socket (0 if not opened)
+	Mona::UInt16			port() const { return _port; }
+
+	// Add the packet of the sender to the queue (it must be already encoded)
+	void					send(const std::shared_ptr<RTMFPSender>& pSender);
+
+	// Send all the queued packets with as few system calls as possible
+	void					flush();
+
+	// Counters
+	std::atomic<Mona::UInt64>	receiveCalls; // number of recvmmsg calls which have returned datagrams
+	std::atomic<Mona::UInt64>	packetsReceived; // number of datagrams received
+	std::atomic<Mona::UInt64>	sendCalls; // number of sendmmsg calls
+	std::atomic<Mona::UInt64>	packetsSent; // number of datagrams sent
+
+private:
+	// Receiving thread
+	void					run(Mona::Exception& ex);
+
+	const Mona::PoolBuffers&						_poolBuffers;
+	int												_socket; // file descriptor of the socket (-1 if closed)
+	Mona::UInt16									_port; // local port
+	std::atomic<bool>								_stopping; // True if the receiving thread must stop
+
+	std::vector<std::unique_ptr<Mona::PoolBuffer>>	_receiveBuffers; // buffers of the current receiving batch
+	std::mutex										_mutexSend; // protect the sending queue (connections can flush from different threads)
+	std::vector<std::shared_ptr<RTMFPSender>>		_sendQueue; // packets waiting for the next flush
+	std::vector<std::shared_ptr<RTMFPSender>>		_sending; // packets being sent (swapped with _sendQueue)
+	std::mutex										_mutexFlush; // only one flush at a time (manage thread and receiving thread)
+};
@@ -0,0 +1,99 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Mona/Mona.h"
+#include "RTMFP.h"
+#include <atomic>
+
+#define RTMFP_CC_INITIAL_WINDOW		(10*RTMFP_MAX_PACKET_SIZE) // initial congestion window (in bytes)
+#define RTMFP_CC_MIN_WINDOW			(2*RTMFP_MAX_PACKET_SIZE) // minimum congestion window (in bytes)
+#define RTMFP_CC_MAX_WINDOW			0x1000000 // maximum congestion window (in bytes)
+#define RTMFP_CC_DEFAULT_RTT		100 // round-trip time used before the first ping (in msec)
+#define RTMFP_CC_PACING_GAIN		1.25 // pacing rate = gain * window / rtt (faster than the window to not starve it)
+#define RTMFP_CC_BURST_DELAY		100 // depth of the token bucket (in msec at the pacing rate, must cover the manage cycle)
+
+/**************************************************
+CongestionController limits the data sent on a
+connection to what the path can carry :
+- a congestion window of bytes in flight (slow start
+and additive increase on acknowledgments, divided by 2
+on loss and set to the minimum on timeout),
+- a token bucket refilled at window/RTT which paces
+the packets sent.
+Bytes in flight are the bytes of the fragments sent
+and not yet acknowledged by the writers, retransmissions
+replace lost fragments and are not counted again.
+It is not thread safe : the sends, acknowledgments and
+timeouts of its connection are serialized by the lock
+of the socket handler (reception, manage cycle and
+application calls), only the counters are atomic to
+be read by the statistics.
+*/
+class CongestionController : public virtual Mona::Object {
+public:
+	CongestionController();
+
+	// Return true if a new message can be sent (window not full and tokens available)
+	bool				canSend();
+
+	// Called for each packet sent on the connection (consume the tokens)
+	void				onPacketSent(Mona::UInt32 size);
+
+	// Called when a new fragment is sent by a writer
+	void				onDataSent(Mona::UInt32 size) { _inFlight += size; }
+
+	// Called when a fragment is acknowledged (or lost without being repeatable)
+	void				onDataAcknowledged(Mona::UInt32 size);
+
+	// Called when a fragment will never be acknowledged (writer aborted)
+	void				onDataAbandoned(Mona::UInt32 size) { removeInFlight(size); }
+
+	// Called when the receiver reports lost fragments (reduce the window once per round-trip)
+	void				onLoss();
+
+	// Called when the retransmission timeout is raised
+	void				onTimeout();
+
+	// Update the smoothed round-trip time (in msec)
+	void				setRTT(Mona::UInt32 rtt) { _rtt = rtt ? rtt : 1; }
+
+	Mona::UInt32		window() const { return _window; }
+	Mona::UInt32		bytesInFlight() const { return _inFlight; }
+	Mona::UInt32		rtt() const { return _rtt; }
+	// Return the pacing rate (in bytes/sec)
+	Mona::UInt32		pacingRate() const { return (Mona::UInt32)(RTMFP_CC_PACING_GAIN * _window * 1000 / _rtt); }
+
+private:
+	void				removeInFlight(Mona::UInt32 size);
+
+	// Add the tokens earned since the last refill
+	void				refill();
+
+	std::atomic<Mona::UInt32>	_window; // congestion window (in bytes)
+	std::atomic<Mona::UInt32>	_inFlight; // bytes sent and not yet acknowledged
+	std::atomic<Mona::UInt32>	_rtt; // smoothed round-trip time (in msec, see RTTEstimator)
+	Mona::UInt32				_threshold; // slow start threshold (in bytes)
+	double						_tokens; // bytes that can be sent now
+	Mona::Int64					_lastRefill; // time of the last refill (in msec)
+	Mona::Int64					_lastReduction; // time of the last window reduction (in msec)
+};
@@ -25,6 +25,7 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "RTMFPWriter.h"
 #include "RTMFP.h"
 #include "RTMFPSender.h"
+#include "WriterScheduler.h"
 
 class SocketHandler;
 
@@ -32,6 +33,7 @@ namespace ConnectionEvents {
 	struct OnNewWriter : Mona::Event<void(std::shared_ptr<RTMFPWriter>&)> {}; // called when a new writer is created
 	struct OnWriterFailed : Mona::Event<void(std::shared_ptr<RTMFPWriter>&)> {}; // called when a writer fail
 	struct OnWriterClose : Mona::Event<void(std::shared_ptr<RTMFPWriter>&)> {}; // called when a writer is closed
+	struct OnFlush : Mona::Event<void()> {}; // called before sending a packet (to complete it with delayed acknowledgments)
 };
 
 /**************************************************
@@ -41,7 +43,8 @@ used to send handshake messages
 class Connection : public BandWriter, 
 	public ConnectionEvents::OnNewWriter,
 	public ConnectionEvents::OnWriterFailed,
-	public ConnectionEvents::OnWriterClose {
+	public ConnectionEvents::OnWriterClose,
+	public ConnectionEvents::OnFlush {
 public:
 	Connection(SocketHandler* pHandler);
 
@@ -67,7 +70,8 @@ public:
 	void									clearWriters();
 
 	// Read data received from server/peer
-	void									process(Mona::PoolBuffer& buffer);
+	// idStream : near session id already unpacked by the socket handler (the buffer starts after it)
+	void									process(Mona::PoolBuffer& buffer, Mona::UInt32 idStream);
 
 	// Return ping to calculate the latency
 	Mona::UInt16							ping() { return _ping; }
@@ -90,6 +94,30 @@ public:
 
 	virtual void							flush() { flush(connected(), connected() ? 0x89 : 0x0B); }
 
+	virtual CongestionController&			congestion() { return _congestion; }
+
+	virtual bool							canSend(Mona::UInt8 priority) { return _scheduler.canSend(priority, _congestion); }
+
+	virtual const RTTEstimator&				rtt() { return _rtt; }
+
+	virtual void							onExpired(Mona::UInt32 size) { _expiredBytes += size; }
+
+	virtual TimerWheel&						timers() { return *_pTimers; }
+
+	virtual void							wakeUp() { _pTimers->anticipate(_timer, _pTimers->now()); _pFlushes->anticipate(_flushTimer, _pFlushes->now()); }
+
+	virtual void							flushLater();
+
+	// Return the bytes of media messages expired and abandoned by the writers
+	Mona::UInt64							expiredBytes() const { return _expiredBytes; }
+
+	// Return the number of packets sent and their size (the mean fill ratio is bytesSent / (packetsSent * RTMFP_MAX_PACKET_SIZE))
+	Mona::UInt64							packetsSent() const { return _packetsSent; }
+	Mona::UInt64							bytesSent() const { return _bytesSent; }
+	// Return the number of packets that would have been sent in addition if each writer had flushed its packet once finished to write
+	// (the fill ratio without the packing is bytesSent / ((packetsSent + flushesDeferred) * RTMFP_MAX_PACKET_SIZE))
+	Mona::UInt64							flushesDeferred() const { return _flushesDeferred; }
+
 	virtual const std::string&				name() { return _address.toString(); }
 
 	virtual bool							connected() { return _status == RTMFP::CONNECTED; }
@@ -118,6 +146,10 @@ protected:
 	// Send the waiting messages
 	void							flushWriters(); // TODO: make it private in the class parent Connection
 
+	std::shared_ptr<TimerWheel>								_pTimers; // Timer wheel of the socket handler (kept while the writers can arm their timer)
+	TimerWheel::Timer										_timer; // Raise manage() (handshake attempts, ping and new messages of the writers)
+	std::shared_ptr<TimerWheel>								_pFlushes; // Flushes of the socket handler raised at the end of the reception
+	TimerWheel::Timer										_flushTimer; // Raise flushWriters() at the end of the reception (new messages written while processing the packets)
 	RTMFP::SessionStatus									_status; // Connection status (stopped, connecting, connected or failed)
 	Mona::Time												_closeTime; // Time since close has been called (to wait before deleting connection)
 	SocketHandler*											_pParent; // Pointer to the socket manager
@@ -137,6 +169,9 @@ private:
 	// Return the writer with this id
 	std::shared_ptr<RTMFPWriter>&	writer(Mona::UInt64 id, std::shared_ptr<RTMFPWriter>& pWriter);
 
+	// Called when the timer of the writer is raised (retransmission timeout or deletion)
+	void							manageWriter(RTMFPWriter& writer);
+
 	std::map<Mona::UInt64, std::shared_ptr<RTMFPWriter>>	_flowWriters; // Map of writers identified by id
 	RTMFPWriter*											_pLastWriter; // Write pointer used to check if it is possible to write
 	Mona::UInt64											_nextRTMFPWriterId;
@@ -147,4 +182,12 @@ private:
 
 	Mona::Time												_lastPing;
 	Mona::UInt16											_ping;
+	CongestionController									_congestion; // congestion window and pacing of the writers
+	WriterScheduler											_scheduler; // order of the new messages of the writers when the congestion window is full
+	RTTEstimator											_rtt; // smoothed round-trip time and retransmission timeout
+	std::atomic<Mona::UInt64>								_expiredBytes; // bytes of the media messages abandoned after their deadline
+	std::atomic<Mona::UInt64>								_packetsSent; // packets sent (handshake included)
+	std::atomic<Mona::UInt64>								_bytesSent; // size of the packets sent before encryption
+	std::atomic<Mona::UInt64>								_flushesDeferred; // packets that the writers would have sent at once without the packing
+	Mona::UInt32											_deferredSize; // size of the current packet at the last flush deferred (to count it once)
 };
\ No newline at end of file
@@ -0,0 +1,80 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Mona/Mona.h"
+#include "Mona/SocketAddress.h"
+#include <vector>
+#include <memory>
+
+class RTMFPConnection;
+/**************************************************
+ConnectionsTable is an open addressing hash table
+of the connections indexed by socket address and
+by near session id (id decoded by RTMFP::Unpack)
+It is built by the SocketHandler each time the
+connections change and is never modified after,
+so it can be read without lock (RCU-style)
+Note: only the lookup of the connection is lock
+free, the packet is then processed under the lock
+of the handler (the handshakes, flows and writers
+are shared with the manage cycle and are not thread
+safe), so the reception still waits for the cycle
+*/
+class ConnectionsTable : public virtual Mona::Object {
+public:
+	// Packed address : IPv6 address (or IPv4 mapped address ::ffff:a.b.c.d) and port
+	struct Key {
+		Key() : high(0), low(0), port(0) {}
+		Key(const Mona::SocketAddress& address);
+
+		bool operator==(const Key& other) const { return high == other.high && low == other.low && port == other.port; }
+		Mona::UInt64	hash() const;
+
+		Mona::UInt64	high;
+		Mona::UInt64	low;
+		Mona::UInt16	port;
+	};
+
+	// Create the table for count connections
+	ConnectionsTable(Mona::UInt32 count);
+
+	// Add a connection to the table (only while building)
+	void											add(const std::shared_ptr<RTMFPConnection>& pConnection);
+
+	// Return the connection with this address or NULL
+	const std::shared_ptr<RTMFPConnection>*			find(const Key& key) const;
+
+	// Return the connection with this near session id or NULL (only unique ids are indexed)
+	const std::shared_ptr<RTMFPConnection>*			find(Mona::UInt32 nearId) const;
+
+	std::vector<std::shared_ptr<RTMFPConnection>>::const_iterator	begin() const { return _connections.begin(); }
+	std::vector<std::shared_ptr<RTMFPConnection>>::const_iterator	end() const { return _connections.end(); }
+
+private:
+	std::vector<std::shared_ptr<RTMFPConnection>>	_connections; // connections in the adding order
+	std::vector<Key>								_keys; // keys of the connections (same order)
+	std::vector<Mona::UInt32>						_addressSlots; // index + 1 of the connection by address slot (0 : empty)
+	std::vector<Mona::UInt32>						_idSlots; // index + 1 of the connection by id slot (0 : empty, 0xFFFFFFFF : id not unique)
+	std::vector<Mona::UInt32>						_ids; // near id of each slot of _idSlots
+	Mona::UInt32									_mask; // number of slots - 1
+};
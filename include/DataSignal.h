@@ -0,0 +1,67 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Mona/Mona.h"
+#include <atomic>
+#if !defined(__linux__)
+	#include <mutex>
+	#include <condition_variable>
+#endif
+
+/**************************************************
+DataSignal notifies a reader thread that data is
+available (single consumer)
+set() is wait-free and only does a system call if
+the reader is sleeping, the reader is woken up as
+soon as data is available (futex on Linux, condition
+variable otherwise)
+*/
+class DataSignal : public virtual Mona::Object {
+public:
+	DataSignal() : _state(EMPTY) {}
+
+	// Producer : notify that data is available
+	void			set();
+
+	// Consumer : clear the signal (the consumer must check its data again after)
+	void			reset() { _state.store(EMPTY); }
+
+	// Consumer : wait until data is available or timeout (in msec)
+	// Return true if data is available
+	bool			wait(Mona::UInt32 millisec);
+
+	bool			isSet() const { return _state.load() == AVAILABLE; }
+
+private:
+	enum State {
+		EMPTY = 0,
+		AVAILABLE,
+		WAITING // empty and the consumer is sleeping
+	};
+
+	std::atomic<Mona::UInt32>	_state;
+#if !defined(__linux__)
+	std::mutex					_mutex;
+	std::condition_variable		_condition;
+#endif
+};
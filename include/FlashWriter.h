@@ -48,11 +48,13 @@ public:
 	};
 
 	bool					reliable;
+	Mona::UInt32			lifetime; // lifetime of the next media messages (in msec), once elapsed they are abandoned rather than repeated (0 for no expiry)
 
 	State					state() { return _state; }
 	void					open() { if(_state==OPENING) _state = OPENED;}
 
 	virtual bool			flush() { return false;  } // return true if something has been sent!
+	virtual Mona::UInt32	waiting() const { return 0; } // number of messages waiting for the network
 	
 	bool					amf0;
 	
@@ -65,6 +67,8 @@ public:
 	AMFWriter&				writeAMFStatus(const char* code, const std::string& description, bool withoutClosing = false) { return writeAMFState("onStatus", code, description, withoutClosing); }
 	AMFWriter&				writeAMFError(const char* code, const std::string& description, bool withoutClosing = false) { return writeAMFState("_error", code, description, withoutClosing); }
 	bool					writeMedia(MediaType type,Mona::UInt32 time, const Mona::UInt8* data, Mona::UInt32 size);
+	// Write an audio or video packet whose payload is shared with the writers of the other listeners (it must not be modified)
+	virtual bool			writeSharedMedia(MediaType type, Mona::UInt32 time, const std::shared_ptr<const Mona::Buffer>& pPayload) { return writeMedia(type, time, pPayload->data(), pPayload->size()); }
 
 	AMFWriter&				writeAMFData(const std::string& name);
 
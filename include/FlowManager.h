@@ -24,6 +24,10 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "Publisher.h"
 #include "FlashConnection.h"
 #include "RTMFPConnection.h"
+#include "MediaRing.h"
+
+#define RTMFP_ACK_DELAY			50 // default maximum delay of an acknowledgment (in msec, raised by the timer of the flow)
+#define RTMFP_ACK_PACKETS		2 // default number of packets received before sending an acknowledgment immediately
 
 // Callback typedef definitions
 typedef void(*OnStatusEvent)(const char*, const char*);
@@ -34,6 +38,7 @@ class Invoker;
 class RTMFPFlow;
 class RTMFPWriter;
 class FlashListener;
+struct RTMFPFrame;
 /**************************************************
 FlowManager is an abstract class used to manage 
 lists of RTMFPFlow and RTMFPWriter
@@ -82,12 +87,43 @@ public:
 	// return : false if the connection is not established
 	bool							readAsync(Mona::UInt8* buf, Mona::UInt32 size, int& nbRead);
 
+	// Read at most count frames without FLV framing, the previous frames read are released before
+	// The data of the frames is read in place and valid until releaseFrames() or the next call
+	// return : false if the connection is not established
+	bool							readFrames(RTMFPFrame* frames, Mona::UInt32 count, int& nbFrames);
+
+	// Release the frames returned by readFrames()
+	void							releaseFrames();
+
 	// Latency (ping / 2)
 	Mona::UInt16					latency();
 
 	// A session is considered closed when it has failed or if it is in NEAR_CLOSED status since at least 90s
 	bool							closed() { return status == RTMFP::FAILED || ((status == RTMFP::NEAR_CLOSED) && _closeTime.isElapsed(90000)); }
 
+	// Set the acknowledgment policy of the flows (delay in msec, 0 to acknowledge each packet immediately)
+	void							setAckPolicy(Mona::UInt32 delay, Mona::UInt32 packets) { _ackDelay = delay; _ackPackets = packets; }
+
+	// Return the number of acknowledgment packets saved (delayed and coalesced or sent with an other packet)
+	Mona::UInt64					acksSaved() const { return _acksSaved; }
+
+	// Return the size of the fragments received out of order by the flows (updated at each reception)
+	Mona::UInt32					reorderBytes() const { return _reorderBytes; }
+
+	// Return the maximum reordering depth of the flows (updated at each reception)
+	Mona::UInt32					reorderDepth() const { return _reorderDepth; }
+
+	// Return the number of media frames dropped because the read buffer was full (asynchronous read)
+	Mona::UInt64					droppedFrames() const { return _droppedFrames; }
+
+	// Return the bytes of media messages abandoned by the writers after their lifetime
+	Mona::UInt64					expiredBytes() const { return _pConnection ? _pConnection->expiredBytes() : 0; }
+
+	// Return the number of packets sent by the connection and their size
+	Mona::UInt64					packetsSent() const { return _pConnection ? _pConnection->packetsSent() : 0; }
+	Mona::UInt64					bytesSent() const { return _pConnection ? _pConnection->bytesSent() : 0; }
+	Mona::UInt64					flushesDeferred() const { return _pConnection ? _pConnection->flushesDeferred() : 0; }
+
 protected:
 
 	// Analyze packets received from the server (must be connected)
@@ -123,9 +159,6 @@ protected:
 	// Create a flow for special signatures (NetGroup)
 	virtual RTMFPFlow*			createSpecialFlow(Mona::Exception& ex, Mona::UInt64 id, const std::string& signature, Mona::UInt64 idWriterRef) = 0;
 
-	// Manage the flows
-	virtual void				manage();
-
 	enum HandshakeType {
 		BASE_HANDSHAKE = 0x0A,
 		P2P_HANDSHAKE = 0x0F
@@ -148,6 +181,7 @@ protected:
 	RTMFPConnection::OnNewWriter::Type					onNewWriter; // Received when the connection create a new writer
 	RTMFPConnection::OnWriterFailed::Type				onWriterFailed; // Received when the writer fail
 	RTMFPConnection::OnWriterClose::Type				onWriterClose; // Received when the writer is closed
+	RTMFPConnection::OnFlush::Type						onFlush; // Received when the connection is sending a packet
 
 	// Job Members
 	std::shared_ptr<FlashConnection>					_pMainStream; // Main Stream (NetConnection or P2P Connection Handler)
@@ -158,6 +192,16 @@ protected:
 
 	FlashListener*										_pListener; // Listener of the main publication (only one by intance)
 
+	// Acknowledgments
+	Mona::UInt32										_ackDelay; // maximum delay of an acknowledgment (in msec)
+	Mona::UInt32										_ackPackets; // number of packets received before sending an acknowledgment
+	std::atomic<Mona::UInt64>							_acksSaved; // number of acknowledgment packets saved
+	TimerWheel::Timer									_ackTimer; // Flush the delayed acknowledgments written in the cycle
+
+	// Reordering statistics of the flows
+	std::atomic<Mona::UInt32>							_reorderBytes;
+	std::atomic<Mona::UInt32>							_reorderDepth;
+
 private:
 
 	// Unsubscribe from all events of the connection
@@ -166,22 +210,25 @@ private:
 	// Remove a flow from the list of flows
 	void												removeFlow(RTMFPFlow* pFlow);
 
+	// Arm the timer of the flow at its next deadline (delayed acknowledgment or deletion)
+	void												scheduleFlow(RTMFPFlow& flow);
+
+	// Called by the timer of a flow : send its delayed acknowledgment or delete it
+	void												manageFlow(RTMFPFlow& flow, Mona::Int64 now);
+
 	std::map<Mona::SocketAddress, std::shared_ptr<RTMFPConnection>>				_mapConnections; // map of connections to all addresses of the session
 
 	Mona::Time																	_closeTime; // Time since closure
 
 	// Asynchronous read
-	struct RTMFPMediaPacket : public Mona::Object {
-
-		RTMFPMediaPacket(const Mona::PoolBuffers& poolBuffers, const Mona::UInt8* data, Mona::UInt32 size, Mona::UInt32 time, bool audio);
-
-		Mona::PoolBuffer	pBuffer;
-		Mona::UInt32		pos;
-	};
-	std::map<std::string, std::deque<std::shared_ptr<RTMFPMediaPacket>>>		_mediaPackets;
-	std::recursive_mutex														_readMutex;
+	std::atomic<MediaRing*>														_pMediaRing; // FLV tags waiting to be read (created with the first media, deleted with the session)
+	std::mutex																	_writeMutex; // serialize the producers of the ring (reception and NetGroup management), the reader never locks
+	bool																		_waitKeyFrame; // True after a video frame dropped, the video is dropped until the next key frame (_writeMutex must be locked)
+	std::atomic<Mona::UInt64>													_droppedFrames; // number of media frames dropped because the ring was full
 	bool																		_firstRead;
 	static const char															_FlvHeader[];
+	Mona::UInt32																_framesSize; // size of the tags read by readFrames() and not released
+	Mona::Buffer																_frameBuffer; // payload of a frame wrapping around the end of the ring
 
 	// Read
 	bool																		_firstMedia;
@@ -24,9 +24,10 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "Mona/Mona.h"
 #include "P2PSession.h"
 #include "GroupListener.h"
+#include "SlidingWindow.h"
 
 namespace GroupMediaEvents {
-	struct OnGroupPacket : Mona::Event<void(Mona::UInt32 time, const Mona::UInt8* data, Mona::UInt32 size, double lostRate, bool audio)> {}; // called when receiving a new packet
+	struct OnGroupPacket : Mona::Event<void(Mona::UInt32 time, const Mona::UInt8* data, Mona::UInt32 size, double lostRate, bool audio)> {}; // called when receiving a new packet (data is valid only during the call)
 }
 
 class MediaPacket;
@@ -37,12 +38,9 @@ from a NetGroup connection
 class GroupMedia : public virtual Mona::Object,
 	public GroupMediaEvents::OnGroupPacket {
 public:
-	GroupMedia(const Mona::PoolBuffers& poolBuffers, const std::string& name, const std::string& key, std::shared_ptr<RTMFPGroupConfig> parameters);
+	GroupMedia(const Mona::PoolBuffers& poolBuffers, TimerWheel& timers, const std::string& name, const std::string& key, std::shared_ptr<RTMFPGroupConfig> parameters);
 	virtual ~GroupMedia();
 
-	// Regularly called to send the fragments maps, the pull requests and the push requests
-	void						manage();
-
 	// Add the peer to map of peer, return false if the peer is already known
 	void						addPeer(const std::string& peerId, std::shared_ptr<PeerMedia>& pPeer);
 	
@@ -62,21 +60,24 @@ public:
 private:
 	#define MAP_PEERS_INFO_TYPE std::map<std::string, std::shared_ptr<PeerMedia>>
 	#define MAP_PEERS_INFO_ITERATOR_TYPE std::map<std::string, std::shared_ptr<PeerMedia>>::iterator
-	#define MAP_FRAGMENTS_ITERATOR std::map<Mona::UInt64, MediaPacket>::iterator
 
-	// Add a new fragment to the map _fragments
-	void						addFragment(MAP_FRAGMENTS_ITERATOR& itFragment, PeerMedia* pPeer, Mona::UInt8 marker, Mona::UInt64 id, Mona::UInt8 splitedNumber, Mona::UInt8 mediaType, Mona::UInt32 time, const Mona::UInt8* data, Mona::UInt32 size);
+	// Add a new fragment to the window _fragments
+	// Return NULL if the fragment is too far from the current window
+	MediaPacket*				addFragment(PeerMedia* pPeer, Mona::UInt8 marker, Mona::UInt64 id, Mona::UInt8 splitedNumber, Mona::UInt8 mediaType, Mona::UInt32 time, const Mona::UInt8* data, Mona::UInt32 size);
 
 	// Push an arriving fragment to the peers and write it into the output file (recursive function)
-	bool						pushFragment(std::map<Mona::UInt64, MediaPacket>::iterator& itFragment);
+	bool						pushFragment(Mona::UInt64 fragmentId);
 
-	// Update the fragment map
+	// Update the fragment map (serialized from the presence bitmap of the window, only if it has changed)
 	// Return 0 if there is no fragments, otherwise the last fragment number
 	Mona::UInt64				updateFragmentMap();
 
 	// Erase old fragments (called before generating the fragments map)
 	void						eraseOldFragments();
 
+	// Called by _fragmentsMapTimer : send the Fragments Map message (or erase the old fragments if there is no peer)
+	void						manageFragmentsMap(Mona::Int64 now);
+
 	// Calculate the push play mode balance and send the requests if needed
 	void						sendPushRequests();
 
@@ -91,6 +92,11 @@ private:
 	// Send the fragment pull request to the next available peer
 	bool						sendPullToNextPeer(Mona::UInt64 idFragment);
 
+	// Send the fragment pull request to the next peer having the fragment in its availability word (see _pullPeers)
+	// bit : position of the fragment in the availability words
+	// current : position of the current pull peer in _pullPeers (_pullPeers.size() if no peer)
+	bool						sendPullToNextPeer(Mona::UInt64 idFragment, Mona::UInt8 bit, size_t& current);
+
 	// Remove the peer from the map
 	void						removePeer(const std::string& peerId);
 
@@ -99,17 +105,20 @@ private:
 
 	const std::string&											_stream; // stream name
 	const std::string											_streamKey; // stream key
-	const Mona::PoolBuffers&									_poolBuffers; // Pool buffer used to write media packets
+	const Mona::PoolBuffers&									_poolBuffers; // Pool buffer used to write function calls
 
-	Mona::Time													_lastPushUpdate; // last Play Push calculation
-	Mona::Time													_lastPullUpdate; // last Play Pull calculation
-	Mona::Time													_lastFragmentsMap; // last Fragments Map Message calculation
+	TimerWheel&													_timers; // Timer wheel of the session
+	Mona::Int64													_lastPushUpdate; // last Play Push calculation (clock of the timer wheel)
+	TimerWheel::Timer											_pushTimer; // Raise the Play Push calculation every NETGROUP_PUSH_DELAY
+	TimerWheel::Timer											_pullTimer; // Raise the Play Pull calculation every NETGROUP_PULL_DELAY
+	TimerWheel::Timer											_fragmentsMapTimer; // Raise the Fragments Map Message every availabilityUpdatePeriod
 
-	std::map<Mona::UInt64, MediaPacket>							_fragments;
-	std::map<Mona::UInt32, Mona::UInt64>						_mapTime2Fragment; // Map of time to fragment (only START and DATA fragments are referenced)
+	SlidingWindow<MediaPacket>									_fragments; // Window of fragments indexed by fragment id
 	Mona::UInt64												_fragmentCounter; // Current fragment counter of writed fragments (fragments sent to application)
+	Mona::Buffer												_payloadBuffer; // Buffer used to reassemble the splitted fragments, reused for each frame
 
-	static Mona::Buffer											_fragmentsMapBuffer; // General buffer for fragments map
+	Mona::Buffer												_fragmentsMapBuffer; // Buffer of the last fragments map generated
+	bool														_fragmentsMapChanged; // True if the window of fragments has changed since the last fragments map
 	static Mona::UInt32											GroupMediaCounter; // static counter of GroupMedia for id assignment
 
 	MAP_PEERS_INFO_TYPE											_mapPeers; // map of peers subscribed to this media stream
@@ -130,11 +139,18 @@ private:
 
 	 // Pull calculation TODO: convert PullRequest to a pair<peerId, time>
 	struct PullRequest : public Object {
-		PullRequest(std::string id) : peerId(id) {}
+		PullRequest(std::string id, Mona::Int64 time) : peerId(id), time(time) {}
 
 		std::string peerId; // Id of the peer to which we have send the pull request
-		Mona::Time time; // Time when the request have been done
+		Mona::Int64 time; // Time when the request have been done (clock of the timer wheel)
+	};
+	struct PullPeer {
+		PullPeer(const MAP_PEERS_INFO_ITERATOR_TYPE& itPeer) : itPeer(itPeer), fragments(0) {}
+
+		MAP_PEERS_INFO_ITERATOR_TYPE	itPeer;
+		Mona::UInt64					fragments; // Availability of the 64 fragments currently analyzed
 	};
+	std::vector<PullPeer>										_pullPeers; // Peers in the order of _mapPeers with their availability (used to find the holes)
 	std::map<Mona::UInt64, PullRequest>							_mapWaitingFragments; // Map of waiting fragments in Pull requests to peer Id
 	std::map<Mona::Int64, Mona::UInt64>							_mapPullTime2Fragment; // Map of reception time to fragments map id (used for pull requests)
 	Mona::UInt64												_lastFragmentMapId; // Last Fragments map Id received (used for pull requests)
@@ -24,24 +24,70 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "Mona/SocketManager.h"
 #include "Mona/TerminateSignal.h"
 #include "RTMFPSession.h"
+#include <atomic>
 
 #define DELAY_CONNECTIONS_MANAGER	50 // Delay between each onManage (in msec)
+#define MAX_CONNECTIONS_SHARDS		64 // Maximum number of threads managing the connections (an index of connection is : number * MAX_CONNECTIONS_SHARDS + shard)
 
-class Invoker;
-// Thread class that call manage() function of the connections each second to flush the writers and send ping requests
+class ConnectionsShard;
+// Thread class that call manage() function of the connections of a shard each DELAY_CONNECTIONS_MANAGER to raise their timers (flush, ping...)
 class ConnectionsManager : private Mona::Task, public Mona::Startable, public virtual Mona::Object {
 public:
-	ConnectionsManager(Invoker& invoker);
+	ConnectionsManager(ConnectionsShard& shard);
 	virtual ~ConnectionsManager() {}
 private:
 	void run(Mona::Exception& ex);
 	void handle(Mona::Exception& ex);
-	Invoker& _invoker;
+	ConnectionsShard& _shard;
+};
+
+class Invoker;
+/**************************************************
+ConnectionsShard is a group of connections managed
+by its own thread with its own lock, the manage
+cycles, the publications and the API calls of its
+connections never wait for the other shards
+*/
+class ConnectionsShard : public Mona::TaskHandler, private Mona::Startable, public virtual Mona::Object {
+friend class ConnectionsManager;
+public:
+	ConnectionsShard(Invoker& invoker);
+	virtual ~ConnectionsShard();
+
+	// Start the thread of the shard and its manager
+	bool			start();
+
+	// Stop the threads of the shard (connections are kept)
+	void			stop() { Mona::Startable::stop(); }
+
+	void			addConnection(unsigned int index, std::shared_ptr<RTMFPSession>& pConn);
+
+	bool			getConnection(unsigned int index, std::shared_ptr<RTMFPSession>& pConn);
+
+	// Remove the connection, return false if it was not found
+	bool			removeConnection(unsigned int index);
+
+	void			clear();
+
+	// Return the number of connections of the shard
+	Mona::UInt32	count() const { return _count; }
+
+private:
+	void			manage();
+	void			requestHandle() { wakeUp(); }
+	void			run(Mona::Exception& exc);
+
+	Invoker&										_invoker;
+	ConnectionsManager								_manager;
+
+	std::recursive_mutex							_mutexConnections;
+	std::map<int, std::shared_ptr<RTMFPSession>>	_mapConnections;
+	std::atomic<Mona::UInt32>						_count; // number of connections (read without lock to place the new connections)
 };
 
 class RTMFPLogger;
 class Invoker : public Mona::TaskHandler, private Mona::Startable {
-friend class ConnectionsManager;
+friend class ConnectionsShard;
 public:
 
 	Invoker(Mona::UInt16 threads);
@@ -50,6 +96,10 @@ public:
 	// Start the socket manager if not started
 	bool			start();
 
+	// Set the maximum number of threads managing the connections (shards are started when needed)
+	void			setManagerThreads(Mona::UInt16 threads);
+
+	// Add the connection to the shard having the fewest connections and return its index
 	unsigned int	addConnection(std::shared_ptr<RTMFPSession>& pConn);
 
 	bool			getConnection(unsigned int index, std::shared_ptr<RTMFPSession>& pConn);
@@ -69,15 +119,22 @@ public:
 	Mona::PoolThreads						poolThreads;
 	const Mona::PoolBuffers					poolBuffers;
 private:
-	virtual void		manage();
 	void				requestHandle() { wakeUp(); }
 	void				run(Mona::Exception& exc);
 
-	bool											_init; // True if at least a connection has been added
-	ConnectionsManager								_manager;
-	int												_lastIndex; // last index of connection
+	// Return the shard of the connection index, NULL if the index is not valid
+	ConnectionsShard*	shard(unsigned int index);
 
-	std::recursive_mutex							_mutexConnections;
-	std::map<int, std::shared_ptr<RTMFPSession>>	_mapConnections;
+	// Terminate if there is no more connection (called by a shard which has removed a connection)
+	// The check is done under _mutexShards so no connection can be added meanwhile
+	void				terminateIfEmpty();
+
+	std::atomic<bool>								_init; // True if at least a connection has been added
+	unsigned int									_lastIndex; // last number of connection
+
+	std::mutex										_mutexShards; // serialize the additions of connections (and the creation of the shards) with the termination
+	std::unique_ptr<ConnectionsShard>				_shards[MAX_CONNECTIONS_SHARDS]; // shards by index, only created slots are read without lock
+	std::atomic<Mona::UInt16>						_nbShards; // number of shards created
+	std::atomic<Mona::UInt16>						_maxShards; // maximum number of shards
 	std::unique_ptr<RTMFPLogger>					_globalLogger;
 };
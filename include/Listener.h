@@ -38,6 +38,9 @@ public:
 
 	virtual void flush() = 0;
 
+	// Return the number of media messages waiting for the network (the publisher waits when it is too high)
+	virtual Mona::UInt32 waiting() const { return 0; }
+
 	const Publisher&	publication;
 	const std::string&	identifier;
 
@@ -64,14 +67,17 @@ public:
 
 	virtual void flush();
 
+	virtual Mona::UInt32 waiting() const;
+
 	bool receiveAudio;
 	bool receiveVideo;
 
 private:
 
-	bool writeReliableMedia(FlashWriter& writer, FlashWriter::MediaType type, Mona::UInt32 time, Mona::PacketReader& packet) { return writeMedia(writer, true, type, time, packet.data(), packet.size()); }
-	bool writeMedia(FlashWriter& writer, FlashWriter::MediaType type, Mona::UInt32 time, const Mona::UInt8* data, Mona::UInt32 size) { return writeMedia(writer, _reliable, type, time, data, size); }
-	bool writeMedia(FlashWriter& writer, bool reliable, FlashWriter::MediaType type, Mona::UInt32 time, const Mona::UInt8* data, Mona::UInt32 size);
+	bool writeReliableMedia(FlashWriter& writer, FlashWriter::MediaType type, Mona::UInt32 time, Mona::PacketReader& packet) { return writeMedia(writer, true, 0, type, time, packet.data(), packet.size()); }
+	bool writeMedia(FlashWriter& writer, FlashWriter::MediaType type, Mona::UInt32 time, const Mona::UInt8* data, Mona::UInt32 size) { return writeMedia(writer, _reliable, 0, type, time, data, size); }
+	// lifetime : time (in msec) after which the message is abandoned rather than repeated, 0 for no expiry
+	bool writeMedia(FlashWriter& writer, bool reliable, Mona::UInt32 lifetime, FlashWriter::MediaType type, Mona::UInt32 time, const Mona::UInt8* data, Mona::UInt32 size);
 
 	bool	initWriters();
 	bool	firstTime() { return !_pVideoWriter && !_pAudioWriter && !_dataInitialized; }
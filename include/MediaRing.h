@@ -0,0 +1,87 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Mona/Mona.h"
+#include "Mona/Buffer.h"
+#include <atomic>
+
+#define FLV_TAG_HEADER_SIZE		11 // type, size, time, time extended, stream id
+#define FLV_TAG_FOOTER_SIZE		4 // previous tag size
+#define RTMFP_MEDIA_RING_SIZE	0x400000 // capacity of the ring of FLV tags of a session (4MB)
+
+/**************************************************
+MediaRing is a single producer/single consumer ring
+of bytes containing the FLV tags of a session
+The tag header and the payload are written once by
+the producer (reception thread), then the consumer
+(RTMFP_Read) copies the bytes out or reads them in
+place by spans (RTMFP_ReadFrames), without lock
+*/
+class MediaRing : public virtual Mona::Object {
+public:
+	// capacity must be a power of 2
+	MediaRing(Mona::UInt32 capacity);
+
+	/* Producer */
+
+	// Write an FLV tag (header + payload + footer)
+	// Return false if there is not enough space (the tag is not written)
+	bool				writeTag(Mona::UInt8 type, Mona::UInt32 time, const Mona::UInt8* data, Mona::UInt32 size);
+
+	// Write bytes already formatted (complete FLV tags)
+	// Return false if there is not enough space (nothing is written)
+	bool				write(const Mona::UInt8* data, Mona::UInt32 size);
+
+	// Return the number of bytes writable
+	Mona::UInt32		space() const { return capacity() - (Mona::UInt32)(_writePos.load(std::memory_order_relaxed) - _readPos.load(std::memory_order_acquire)); }
+
+	/* Consumer */
+
+	// Return the number of bytes readable
+	Mona::UInt32		available() const { return (Mona::UInt32)(_writePos.load(std::memory_order_acquire) - _readPos.load(std::memory_order_relaxed)); }
+	bool				empty() const { return !available(); }
+
+	// Copy at most size bytes into buffer and return the number of bytes copied
+	Mona::UInt32		read(Mona::UInt8* buffer, Mona::UInt32 size);
+
+	// Return the next contiguous readable bytes after the first from bytes (size is set to 0 if there is nothing more to read)
+	// The span is valid until consume() is called
+	const Mona::UInt8*	span(Mona::UInt32& size, Mona::UInt32 from = 0) const;
+
+	// Copy size bytes readable from offset into buffer without consuming them, return the number of bytes copied
+	Mona::UInt32		peek(Mona::UInt32 offset, Mona::UInt8* buffer, Mona::UInt32 size) const;
+
+	// Release size bytes read in place
+	void				consume(Mona::UInt32 size) { _readPos.store(_readPos.load(std::memory_order_relaxed) + size, std::memory_order_release); }
+
+	Mona::UInt32		capacity() const { return _mask + 1; }
+
+private:
+	// Copy data at the position of the ring (handle the wrap)
+	void				copy(Mona::UInt64 position, const Mona::UInt8* data, Mona::UInt32 size);
+
+	Mona::Buffer				_buffer;
+	const Mona::UInt32			_mask; // capacity - 1
+	std::atomic<Mona::UInt64>	_writePos; // total of bytes written (modified by the producer only)
+	std::atomic<Mona::UInt64>	_readPos; // total of bytes read (modified by the consumer only)
+};
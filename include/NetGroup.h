@@ -73,9 +73,6 @@ public:
 	// Return True if the peer doesn't already exists
 	bool			checkPeer(const std::string& peerId);
 
-	// Manage the netgroup peers and send the recurrent requests
-	void			manage();
-
 	// Call a function on the peer side
 	// return 0 if it fails, 1 otherwise
 	unsigned int	callFunction(const char* function, int nbArgs, const char** args);
@@ -119,6 +116,12 @@ private:
 	// Connect and disconnect peers to fit the best list
 	void						manageBestConnections();
 
+	// Called by _reportTimer : send the Group Report message to a random connected peer
+	void						manageReport(Mona::Int64 now);
+
+	// Called by the timer of a peer of the heard list : delete it if we have no report since NETGROUP_PEER_TIMEOUT
+	void						manageHeardPeer(std::map<std::string, GroupNode>::iterator itNode, Mona::Int64 now);
+
 	P2PEvents::OnPeerGroupBegin::Type						onGroupBegin;
 	P2PEvents::OnPeerGroupReport::Type						onGroupReport;
 	P2PEvents::OnNewMedia::Type								onNewMedia;
@@ -133,8 +136,9 @@ private:
 	MAP_PEERS_TYPE											_mapPeers; // Map of peers ID to p2p connections
 	GroupListener*											_pListener; // Listener of the main publication (only one by intance)
 	RTMFPSession&											_conn; // RTMFPSession related to
-	Mona::Time												_lastBestCalculation; // last Best list calculation
-	Mona::Time												_lastReport; // last Report Message calculation
+	Mona::Int64												_lastReport; // last Report Message calculation (clock of the timer wheel)
+	TimerWheel::Timer										_bestListTimer; // Raise the Best list calculation every NETGROUP_BEST_LIST_DELAY
+	TimerWheel::Timer										_reportTimer; // Raise the Group Report every NETGROUP_REPORT_DELAY
 	Mona::Buffer											_reportBuffer; // Buffer for reporting messages
 
 	std::map<std::string, GroupMedia>						_mapGroupMedias; // map of stream key to GroupMedia
@@ -0,0 +1,154 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Mona/Mona.h"
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <new>
+
+#define RTMFP_POOL_MAX_FREE		1024 // maximum number of free objects kept by thread and by type (the others are given back to the allocator)
+
+/**************************************************
+ObjectPools gives the counters shared by all the
+pools of objects (see ObjectPool)
+The counters are kept by thread, without lock and
+without sharing a cache line with the other
+threads, and they are summed by Read()
+*/
+class ObjectPools : virtual Mona::Static {
+public:
+	// Record the allocation of an object (recycled : true if it comes from a free list)
+	static void		Allocated(bool recycled) {
+		Counters& counters(Local());
+		counters.allocations.fetch_add(1, std::memory_order_relaxed);
+		if (recycled)
+			counters.hits.fetch_add(1, std::memory_order_relaxed);
+	}
+	// Record the release of an object (by any thread)
+	static void		Released() { Local().releases.fetch_add(1, std::memory_order_relaxed); }
+
+	// Sum the counters of all the threads
+	// allocations : number of objects allocated by the pools, hits : number of allocations served by a free list
+	// peak : maximum number of pooled objects allocated at the same time (updated by each call)
+	static void		Read(Mona::UInt64& allocations, Mona::UInt64& hits, Mona::UInt32& peak);
+
+private:
+	struct Counters : virtual Mona::Object {
+		Counters() : allocations(0), hits(0), releases(0) {}
+
+		std::atomic<Mona::UInt64>	allocations;
+		std::atomic<Mona::UInt64>	hits;
+		std::atomic<Mona::UInt64>	releases; // (an object can be released by another thread, only the sum is meaningful)
+	};
+	struct ThreadCounters;
+
+	// Return the counters of the calling thread (the counters of the exited threads at the end of the thread)
+	static Counters&	Local();
+
+	static std::mutex				_Mutex; // protect the list of the threads and the peak
+	static std::set<Counters*>		_Threads; // counters of the running threads
+	static Counters					_Exited; // counters of the exited threads
+	static Mona::UInt32				_Peak;
+};
+
+/**************************************************
+ObjectPool keeps the memory of the deleted objects
+of a type in a free list by thread to reuse it for
+the next objects, without lock and without going
+back to the general purpose allocator
+The type must declare the operators new and delete
+calling Allocate and Release
+Note: an object can be deleted by another thread
+than the one which has created it, its memory goes
+to the free list of the deleting thread
+*/
+template<typename Type>
+class ObjectPool : virtual Mona::Static {
+public:
+	static void*	Allocate(std::size_t size) {
+		if (size != sizeof(Type)) // derived type
+			return ::operator new(size);
+
+		FreeList* pList(Local());
+		Block* pBlock = pList ? pList->pHead : NULL;
+		if (pBlock) {
+			pList->pHead = pBlock->pNext;
+			--pList->count;
+		}
+		ObjectPools::Allocated(pBlock != NULL);
+		return pBlock ? pBlock : ::operator new(size);
+	}
+
+	static void		Release(void* p, std::size_t size) {
+		if (!p)
+			return;
+		if (size != sizeof(Type)) {
+			::operator delete(p);
+			return;
+		}
+		ObjectPools::Released();
+		FreeList* pList(Local());
+		if (!pList || pList->count >= RTMFP_POOL_MAX_FREE) {
+			::operator delete(p);
+			return;
+		}
+		Block* pBlock = (Block*)p;
+		pBlock->pNext = pList->pHead;
+		pList->pHead = pBlock;
+		++pList->count;
+	}
+
+private:
+	struct Block {
+		Block*	pNext;
+	};
+	static_assert(sizeof(Type) >= sizeof(Block), "Type is too small to be pooled");
+
+	struct FreeList {
+		FreeList(bool& exited) : pHead(NULL), count(0), _exited(exited) {}
+		// Give back the memory at the end of the thread, the next calls of this thread go to the allocator
+		~FreeList() {
+			_exited = true;
+			while (pHead) {
+				Block* pBlock = pHead;
+				pHead = pBlock->pNext;
+				::operator delete(pBlock);
+			}
+		}
+
+		Block*			pHead; // first free block
+		Mona::UInt32	count; // number of free blocks
+	private:
+		bool&			_exited;
+	};
+
+	// Return the free list of the calling thread, NULL if it is already destroyed (end of the thread)
+	static FreeList*	Local() {
+		static thread_local bool Exited(false); // (trivially destructible : still readable after the free list)
+		if (Exited)
+			return NULL;
+		static thread_local FreeList List(Exited);
+		return &List;
+	}
+};
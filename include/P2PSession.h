@@ -108,9 +108,6 @@ public:
 	// called by PeerMedia to close the media report and the media flows
 	void closeFlow(Mona::UInt64 id);
 
-	// Manage the flows
-	virtual void				manage() { FlowManager::manage(); }
-
 	/*** Public members ***/
 
 	Mona::UInt8						attempt; // Number of try to contact the responder (only for initiator)
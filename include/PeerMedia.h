@@ -24,7 +24,7 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "Mona/Mona.h"
 #include "Mona/Event.h"
 #include "Mona/PacketReader.h"
-#include <set>
+#include <vector>
 
 #define MAX_FRAGMENT_MAP_SIZE			1024 // TODO: check this
 
@@ -78,6 +78,10 @@ public:
 	// Return True if the fragment is available
 	bool hasFragment(Mona::UInt64 index);
 
+	// Return the availability of the 64 fragments from index (bit 0) to index + 63 (bit 63)
+	// Blacklisted fragments are seen as unavailable
+	Mona::UInt64 availableFragments(Mona::UInt64 index);
+
 	// Write the Group publication infos
 	void sendGroupMedia(const std::string& stream, const std::string& streamKey, RTMFPGroupConfig* groupConfig);
 
@@ -117,10 +121,12 @@ private:
 	P2PSession*						_pParent; // P2P session related to
 
 	Mona::UInt8						_pushOutMode; // Group Publish Push mode
-	Mona::Buffer					_fragmentsMap; // Last Fragments Map received
+	std::vector<Mona::UInt64>		_fragmentsMap; // Last Fragments Map received, decoded as a bitmap (bit 0 of the first word is the fragment _mapBase)
+	Mona::UInt64					_mapBase; // First fragment of the bitmap _fragmentsMap (multiple of 64)
 	Mona::UInt64					_idFragmentsMapIn; // Last ID received from the Fragments Map
 	Mona::UInt64					_idFragmentsMapOut; // Last ID sent in the Fragments map
-	std::set<Mona::UInt64>			_blacklistPull; // set of fragments blacklisted for pull requests to this peer
+	std::vector<Mona::UInt64>		_blacklistPull; // bitmap of fragments blacklisted for pull requests to this peer (bit 0 of the first word is the fragment _blacklistBase)
+	Mona::UInt64					_blacklistBase; // First fragment of the bitmap _blacklistPull (multiple of 64)
 	std::shared_ptr<RTMFPWriter>	_pMediaReportWriter; // Media Report writer used to send report messages from the current media
 	std::shared_ptr<RTMFPWriter>	_pMediaWriter; // Writer for media packets
 };
@@ -25,20 +25,45 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "FlashWriter.h"
 //#include "Mona/QualityOfService.h"
 #include "DataReader.h"
-#include "Mona/Task.h"
+#include "MediaRing.h"
 #include <deque>
 
-class Invoker;
+#define RTMFP_AUDIO_LIFETIME		2000 // default lifetime of an audio message (in msec) after which it is abandoned rather than repeated
+#define RTMFP_KEYFRAME_LIFETIME		4000 // default lifetime of a video key frame (in msec)
+#define RTMFP_INTERFRAME_LIFETIME	1000 // default lifetime of a video inter frame (in msec)
+#define RTMFP_PUBLISH_QUEUE_SIZE	0x200000 // capacity of the queue of FLV tags written by the application and not published yet (2MB)
+#define RTMFP_PUBLISH_MAX_WAITING	256 // number of media messages waiting for the network in a listener after which the queue is not pushed anymore
+
 class Listener;
-class Publisher : public Mona::Task, public virtual Mona::Object {
+/**************************************************
+Publisher sends the media written by the application
+to its listeners
+The complete FLV tags are copied into a single
+producer/single consumer queue by the application
+thread, which never waits, then the thread managing
+the session pushes them to the listeners at each
+cycle (see drain)
+*/
+class Publisher : public virtual Mona::Object {
 public:
 
-	Publisher(const std::string& name, Invoker& invoker, bool audioReliable, bool videoReliable, bool p2p);
+	Publisher(const std::string& name, const Mona::PoolBuffers& poolBuffers, bool audioReliable, bool videoReliable, bool p2p);
 	virtual ~Publisher();
 
-	// Add packets to the waiting queue
+	// Add the complete FLV tags to the waiting queue (called by the application thread)
+	// pos is set to the number of bytes used, the tags which don't fit in the queue are left to the caller (0 if the queue is full)
+	// Return false if a tag is larger than the queue or if the first tag is invalid (size after the payload), it is never queued
 	bool publish(const Mona::UInt8* data, Mona::UInt32 size, int& pos);
 
+	// Add an audio or video frame to the waiting queue without FLV framing (called by the application thread)
+	// queued is set to false if the queue is full
+	// Return false if the type is unknown or if the frame is larger than the queue
+	bool publish(Mona::UInt8 type, Mona::UInt32 time, const Mona::UInt8* data, Mona::UInt32 size, bool& queued);
+
+	// Push the waiting tags to the listeners and flush them (called by the thread managing the session)
+	// It stops when a listener has too many messages waiting for the network (the application sees the queue full), unless force is set
+	void drain(bool force = false);
+
 	const std::string&		name() const { return _name; }
 
 	void					start();
@@ -64,6 +89,16 @@ public:
 	const Mona::PoolBuffer&		audioCodecBuffer() const { return _audioCodecBuffer; }
 	const Mona::PoolBuffer&		videoCodecBuffer() const { return _videoCodecBuffer; }
 
+	// Set the lifetime of the media messages sent to the listeners (in msec, 0 to repeat them until they are acknowledged)
+	void						setLifetimes(Mona::UInt32 audio, Mona::UInt32 keyFrame, Mona::UInt32 interFrame) { _audioLifetime = audio; _keyFrameLifetime = keyFrame; _interFrameLifetime = interFrame; }
+	Mona::UInt32				audioLifetime() const { return _audioLifetime; }
+	Mona::UInt32				keyFrameLifetime() const { return _keyFrameLifetime; }
+	Mona::UInt32				interFrameLifetime() const { return _interFrameLifetime; }
+
+	// Return the payload of the frame being pushed to the listeners, copied at the first call and shared by their writers
+	// Return NULL if data is not this frame or if there is only one listener (the writer copy is enough)
+	const std::shared_ptr<const Mona::Buffer>&	sharedPayload(const Mona::UInt8* data, Mona::UInt32 size) const;
+
 	bool	isP2P; // If true it is a p2p publisher
 private:
 
@@ -72,8 +107,11 @@ private:
 	/*void pushData(DataReader& packet);
 	void pushProperties(DataReader& packet);*/
 
-	// Task handle : running function to send packets
-	virtual void handle(Mona::Exception& ex);
+	// Push a complete FLV tag to the listeners
+	void pushTag(const Mona::UInt8* tag);
+
+	// Return true if a listener has more than RTMFP_PUBLISH_MAX_WAITING messages waiting for the network
+	bool congested() const;
 
 	void flush();
 
@@ -84,7 +122,6 @@ private:
 	const QualityOfService&	audioQOS() const { return _pAudioWriter ? _pAudioWriter->qos() : QualityOfService::Null; }
 	const QualityOfService&	dataQOS() const { return _writer.qos(); }*/
 
-	Invoker&							_invoker;
 	bool								_running; // If the publication is running
 	std::map<std::string, Listener*>	_listeners; // list of listeners to this publication
 	const std::string					_name; // name of the publication
@@ -95,11 +132,19 @@ private:
 	bool									_videoReliable;
 	bool									_audioReliable;
 
+	Mona::UInt32							_audioLifetime; // lifetime of the audio messages
+	Mona::UInt32							_keyFrameLifetime; // lifetime of the video key frames
+	Mona::UInt32							_interFrameLifetime; // lifetime of the video inter frames
+
 	Mona::PoolBuffer						_audioCodecBuffer;
 	Mona::PoolBuffer						_videoCodecBuffer;
 
 	bool									_new; // True if there is at list a packet to send
 
-	std::unique_ptr<Mona::PacketReader>		_reader; // Current reader of input data
-	int										_pos; // Current position of input data
+	const Mona::UInt8*								_frame; // frame being pushed to the listeners, NULL if there is only one listener
+	Mona::UInt32									_frameSize;
+	mutable std::shared_ptr<const Mona::Buffer>		_pPayload; // copy of the frame shared by the writers of the listeners
+
+	MediaRing								_queue; // FLV tags written by the application and not published yet
+	Mona::Buffer							_tag; // Buffer of a tag wrapping around the end of the queue
 };
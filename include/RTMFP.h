@@ -53,31 +53,24 @@ public:
 		DECRYPT=0,
 		ENCRYPT
 	};
-	RTMFPEngine(const Mona::UInt8* key, Direction direction) : _direction(direction) {
-		memcpy(_key, key, RTMFP_KEY_SIZE);
-		EVP_CIPHER_CTX_init(&_context);
-	}
-	virtual ~RTMFPEngine() {
-		EVP_CIPHER_CTX_cleanup(&_context);
-	}
+	RTMFPEngine(const Mona::UInt8* key, Direction direction);
+	virtual ~RTMFPEngine();
 
-	bool process(Mona::UInt8* data, int size) {
-		int newSize(size);
-		static Mona::UInt8 IV[RTMFP_KEY_SIZE];
-		EVP_CipherInit_ex(&_context, EVP_aes_128_cbc(), NULL, _key, IV,_direction);
-		EVP_CipherUpdate(&_context, data, &newSize, data, size);
+	// Encryption : compute the CRC of the packet (written in the 2 first bytes) and encrypt it
+	// Decryption : decrypt the packet and check its CRC in the same pass, return false if the CRC is wrong
+	bool process(Mona::UInt8* data, int size);
 
-		if (_direction == DECRYPT) { // check CRC
-			Mona::BinaryReader reader(data, size);
-			Mona::UInt16 crc(reader.read16());
-			return (Mona::Crypto::ComputeCRC(reader) == crc);
-		}
-		return true;
-	}
+	// Return the RTMFP checksum of data (one's complement sum of the 16-bit words, same result as Mona::Crypto::ComputeCRC)
+	static Mona::UInt16 ComputeCRC(const Mona::UInt8* data, Mona::UInt32 size);
 
 private:
+	// Add the 16-bit words of data (size must be even) to sum, words are read 4 by 4 in the native byte order
+	static Mona::UInt64 AddWords(const Mona::UInt8* data, Mona::UInt32 size, Mona::UInt64 sum);
+
+	// Fold the sum of words to 16 bits and add the last byte if the size is odd (pLastByte is not null)
+	static Mona::UInt16 FinalizeCRC(Mona::UInt64 sum, const Mona::UInt8* pLastByte);
+
 	Direction				_direction;
-	Mona::UInt8				_key[RTMFP_KEY_SIZE];
 	EVP_CIPHER_CTX			_context;
 };
 
@@ -65,6 +65,9 @@ public:
 	// Return the far nonce (used by P2PSession to calculate the group key)
 	const Mona::Buffer&				farNonce() { return _farNonce; }
 
+	// Return the session id sent to the far peer (used by the peer to send us packets), 0 if not sent yet
+	Mona::UInt32					nearId() const { return _nearId; }
+
 protected:
 
 	// Handle message received
@@ -88,6 +91,9 @@ private:
 	// Send the 2nd handshake response (only in P2P mode)
 	void							sendHandshake78(Mona::BinaryReader& reader);
 
+	// Set the session id sent to the far peer and update the table of connections
+	void							setNearId(Mona::UInt32 nearId);
+
 	// Handle the handshake 70 (from peer or server)
 	void							handleHandshake70(Mona::BinaryReader& reader);
 
@@ -110,6 +116,7 @@ private:
 	Mona::Buffer											_nonce; // Our Nonce for key exchange, can be of size 0x4C or 0x49 for responder
 
 	FlowManager*											_pSession; // Pointer to the session (normal or p2p)
+	Mona::UInt32											_nearId; // Session id sent to the far peer (0 if not sent yet)
 
 	std::recursive_mutex									_mutexConnections; // mutex for waiting p2p connections*/
 };
\ No newline at end of file
@@ -25,6 +25,10 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "FlashConnection.h"
 #include "Mona/PoolBuffers.h"
 #include "BandWriter.h"
+#include "SlidingWindow.h"
+
+#define RTMFP_REORDER_DEPTH		1024 // maximum number of stages buffered after a missing stage
+#define RTMFP_REORDER_BUDGET	0x100000 // maximum size of the fragments buffered after a missing stage (in bytes)
 
 class RTMFPPacket;
 class RTMFPFragment;
@@ -45,23 +49,48 @@ public:
 	// Handle fragments received
 	void	receive(Mona::UInt64 stage,Mona::UInt64 deltaNAck,Mona::PacketReader& fragment,Mona::UInt8 flags);
 	
-	// Send acknowledgment
-	void	commit();
+	// Send acknowledgment now if some stages are missing, if the flow is completed or if maxPackets have been received since the last one
+	// Otherwise the acknowledgment is delayed (see writeAck), return true if it has been sent
+	bool	commit(Mona::UInt32 maxPackets);
+
+	// Write the acknowledgment without flushing, return false if its size exceeds maxSize
+	bool	writeAck(Mona::UInt32 maxSize = RTMFP_MAX_PACKET_SIZE);
+
+	// Return true if an acknowledgment is delayed
+	bool	ackDelayed() const { return _packetsToAck > 0; }
+
+	// Return true if an acknowledgment is delayed since delay msec
+	bool	ackElapsed(Mona::UInt32 delay, Mona::Int64 now) const { return _packetsToAck > 0 && now - _ackTime > delay; }
 
 	void	fail(const std::string& error);
 
 	void	close();
 
-	bool	consumed() { return _completed && _completeTime.isElapsed(120000); } // Wait 120s before closing the flow definetly
+	bool	consumed(Mona::Int64 now) { return _completed && now - _completeTime > 120000; } // Wait 120s before closing the flow definetly
+
+	// Return the time of the next event of the flow (delayed acknowledgment or deletion), 0 if there is nothing to wait
+	Mona::Int64		deadline(Mona::UInt32 ackDelay) const;
+
+	// Return the size of the fragments buffered after a missing stage (in bytes)
+	Mona::UInt32	reorderBytes() const { return _reorderBytes; }
+
+	// Return the maximum distance observed between the last stage delivered and a buffered stage
+	Mona::UInt32	reorderDepth() const { return _reorderDepth; }
+
+	TimerWheel::Timer				timer; // Raise the delayed acknowledgment and the deletion of the flow (see FlowManager::manageFlow)
 
 private:
 	// Handle on fragment received
-	void	onFragment(Mona::UInt64 stage,Mona::PacketReader& fragment,Mona::UInt8 flags);
+	// messageSize : size of the message if known (first fragment of a buffered message)
+	void	onFragment(Mona::UInt64 stage,Mona::PacketReader& fragment,Mona::UInt8 flags,Mona::UInt32 messageSize=0);
+
+	// Handle the first buffered fragment, return false if the flow is completed
+	bool	onBufferedFragment();
 
 	void	complete();
 
 	bool							_completed; // Indicates that the flow is consumed
-	Mona::Time						_completeTime; // Time before closing definetly the flow
+	Mona::Int64						_completeTime; // Time before closing definetly the flow (clock of the timer wheel)
 	BandWriter&						_band; // RTMFP connection to send messages
 	const Mona::UInt64				_stage; // Current stage (index) of messages received
 	std::shared_ptr<FlashStream>	_pStream; // NetStream handler of the flow
@@ -69,8 +98,12 @@ private:
 
 	// Receiving
 	RTMFPPacket*					_pPacket; // current packet/message containing 1 or more fragments (if chunked)
-	std::map<Mona::UInt64,RTMFPFragment>	_fragments; // map of all fragments received and not handled for now
+	SlidingWindow<RTMFPFragment>	_fragments; // window of fragments received after a missing stage (indexed by stage)
+	Mona::UInt32					_reorderBytes; // size of the buffered fragments
+	Mona::UInt32					_reorderDepth; // maximum distance from _stage of a buffered fragment
 	Mona::UInt32					_numberLostFragments;
+	Mona::UInt32					_packetsToAck; // number of packets received since the last acknowledgment
+	Mona::Int64						_ackTime; // time of the first packet not acknowledged (clock of the timer wheel)
 	const Mona::PoolBuffers&		_poolBuffers;
 };
 
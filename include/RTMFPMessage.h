@@ -23,13 +23,14 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "Mona/Mona.h"
 #include "AMFWriter.h"
+#include "ObjectPool.h"
 
 
 class RTMFPMessage : public virtual Mona::Object {
 public:
 
-	RTMFPMessage(bool repeatable) : repeatable(repeatable),_frontSize(0) {}
-	RTMFPMessage(AMF::ContentType type, Mona::UInt32 time, bool repeatable) :   _frontSize(type==AMF::EMPTY ? 0 : (type==AMF::DATA_AMF3 ? 6 : 5)), repeatable(repeatable) {
+	RTMFPMessage(bool repeatable) : repeatable(repeatable),_frontSize(0),deadline(0),priority(0) {}
+	RTMFPMessage(AMF::ContentType type, Mona::UInt32 time, bool repeatable) :   _frontSize(type==AMF::EMPTY ? 0 : (type==AMF::DATA_AMF3 ? 6 : 5)), repeatable(repeatable), deadline(0), priority(0) {
 		if (type == AMF::EMPTY)
 			return;
 		_front[0] = type;
@@ -46,8 +47,12 @@ public:
 
 	Mona::UInt32					size() const { return frontSize()+bodySize(); }
 
-	std::map<Mona::UInt32,Mona::UInt64>	fragments;
+	// Return true if the message has a deadline and it is elapsed (it must be abandoned rather than repeated)
+	bool							expired(Mona::Int64 now) const { return deadline && deadline <= now; }
+
 	const bool				repeatable;
+	Mona::Int64				deadline; // time (in msec) after which the message is useless for the receiver, 0 if it never expires
+	Mona::UInt8				priority; // class of the message in the connection scheduler (see WriterScheduler::Priority)
 private:
 	Mona::UInt8					_front[6];
 	Mona::UInt8					_frontSize;
@@ -59,6 +64,9 @@ public:
 	RTMFPMessageUnbuffered(const Mona::UInt8* data, Mona::UInt32 size) : _data(data), _size(size),RTMFPMessage(false) {}
 	RTMFPMessageUnbuffered(AMF::ContentType type, Mona::UInt32 time,const Mona::UInt8* data, Mona::UInt32 size) : _data(data), _size(size),RTMFPMessage(type,time,false) {}
 
+	static void*	operator new(std::size_t size) { return ObjectPool<RTMFPMessageUnbuffered>::Allocate(size); }
+	static void		operator delete(void* p, std::size_t size) { ObjectPool<RTMFPMessageUnbuffered>::Release(p, size); }
+
 private:
 	const Mona::UInt8*	body() const { return _data; }
 	Mona::UInt32			bodySize() const { return _size; }
@@ -68,6 +76,22 @@ private:
 };
 
 
+class RTMFPMessageShared : public RTMFPMessage, public virtual Mona::Object {
+public:
+	// The payload is shared by the messages of all the listeners of a publication, only the front (type and time) is owned
+	RTMFPMessageShared(AMF::ContentType type, Mona::UInt32 time, const std::shared_ptr<const Mona::Buffer>& pPayload, bool repeatable) : _pPayload(pPayload), RTMFPMessage(type, time, repeatable) {}
+
+	static void*	operator new(std::size_t size) { return ObjectPool<RTMFPMessageShared>::Allocate(size); }
+	static void		operator delete(void* p, std::size_t size) { ObjectPool<RTMFPMessageShared>::Release(p, size); }
+
+private:
+	const Mona::UInt8*	body() const { return _pPayload->data(); }
+	Mona::UInt32			bodySize() const { return _pPayload->size(); }
+
+	std::shared_ptr<const Mona::Buffer>	_pPayload;
+};
+
+
 
 class RTMFPMessageBuffered: public RTMFPMessage, virtual public Mona::NullableObject {
 public:
@@ -78,6 +102,9 @@ public:
 
 	AMFWriter&		writer() { return *_pWriter; }
 
+	static void*	operator new(std::size_t size) { return ObjectPool<RTMFPMessageBuffered>::Allocate(size); }
+	static void		operator delete(void* p, std::size_t size) { ObjectPool<RTMFPMessageBuffered>::Release(p, size); }
+
 	operator bool() const { return *_pWriter; }
 
 private:
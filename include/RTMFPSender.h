@@ -32,6 +32,9 @@ public:
 		packet.next(RTMFP_HEADER_SIZE);
 	}
 	
+	// Pad, encrypt and pack the packet (done by run() or before a batched send)
+	void				encode();
+
 	Mona::UInt32		farId;
 	Mona::PacketWriter	packet;
 
@@ -24,6 +24,7 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "P2PSession.h"
 #include "Mona/HostEntry.h"
 #include "SocketHandler.h"
+#include "DataSignal.h"
 #include <list>
 
 /**************************************************
@@ -31,6 +32,8 @@ RTMFPSession represents a connection to the
 RTMFP Server
 */
 class NetGroup;
+struct RTMFPStatistics;
+struct RTMFPFrame;
 class RTMFPSession : public FlowManager {
 public:
 	RTMFPSession(Invoker* invoker, OnSocketError pOnSocketError, OnStatusEvent pOnStatusEvent, OnMediaEvent pOnMediaEvent);
@@ -41,7 +44,8 @@ public:
 	virtual void close(bool abrupt);
 
 	// Connect to the specified url, return true if the command succeed
-	bool connect(Mona::Exception& ex, const char* url, const char* host);
+	// batchedIO : if true try to use the batched IO mode of the socket (Linux only)
+	bool connect(Mona::Exception& ex, const char* url, const char* host, bool batchedIO = false);
 
 	// Connect to a peer with asking server for the addresses and start playing streamName
 	void connect2Peer(const char* peerId, const char* streamName);
@@ -56,18 +60,39 @@ public:
 	// return : False if the connection is not established, true otherwise
 	bool read(const char* peerId, Mona::UInt8* buf, Mona::UInt32 size, int& nbRead);
 
-	// Write media (netstream must be published)
+	// Asynchronous read of frames without FLV framing (see FlowManager::readFrames)
+	// return : False if the connection is not established, true otherwise
+	bool readFrames(const char* peerId, RTMFPFrame* frames, Mona::UInt32 count, int& nbFrames);
+
+	// Release the frames read with readFrames
+	void releaseFrames(const char* peerId);
+
+	// Write media (netstream must be published), the complete FLV tags are queued and pushed by the thread managing the session
 	// return false if the client is not ready to publish, otherwise true
 	bool write(const Mona::UInt8* buf, Mona::UInt32 size, int& pos);
 
+	// Write media frames without FLV framing (netstream must be published)
+	// queued is set to the number of frames queued (the next ones don't fit in the queue or the next one is invalid)
+	// return false if the client is not ready to publish or if the first frame is invalid, otherwise true
+	bool writeFrames(const RTMFPFrame* frames, Mona::UInt32 count, int& queued);
+
 	// Call a function of a server, peer or NetGroup
 	// param peerId If set to 0 the call we be done to the server, if set to "all" to all the peers of a NetGroup, and to a peer otherwise
 	// return 1 if the call succeed, 0 otherwise
 	unsigned int callFunction(const char* function, int nbArgs, const char** args, const char* peerId = 0);
 
-	// Called by Invoker every second to manage connection (flush and ping)
+	// Called by Invoker at each cycle to raise the timers of the session (flush, ping, acknowledgments...) and send the waiting commands
 	virtual void manage();
 
+	// Return the timer wheel of the session (see TimerWheel)
+	TimerWheel& timers() { return *_pSocketHandler->timers(); }
+
+	// Fill the statistics of the session
+	void getStatistics(RTMFPStatistics& statistics);
+
+	// Set the lifetime of the media messages published (in msec, 0 to repeat them until they are acknowledged)
+	void setMediaLifetimes(Mona::UInt32 audio, Mona::UInt32 keyFrame, Mona::UInt32 interFrame) { _audioLifetime = audio; _keyFrameLifetime = keyFrame; _interFrameLifetime = interFrame; }
+
 	// Add a command to the main stream (play/publish)
 	virtual void addCommand(CommandType command, const char* streamName, bool audioReliable = false, bool videoReliable = false);
 		
@@ -83,7 +108,7 @@ public:
 		return _pPublisher->addListener<ListenerType, Args...>(ex, peerId, args...);
 	}
 
-	// Push the media packet to write into a file
+	// Push the media packet to write into a file (data is read in place, it is valid only during the call)
 	void pushMedia(const std::string& stream, Mona::UInt32 time, const Mona::UInt8* data, Mona::UInt32 size, double lostRate, bool audio) { 
 		Mona::PacketReader reader(data, size);
 		onMedia(stream, time, reader, lostRate, audio); 
@@ -134,12 +159,11 @@ public:
 	Mona::Signal					p2pPublishSignal; // signal to wait p2p publish
 	Mona::Signal					p2pPlaySignal; // signal to wait p2p publish
 	Mona::Signal					publishSignal; // signal to wait publication
-	Mona::Signal					readSignal; // signal to wait for asynchronous data
+	DataSignal						readSignal; // signal to wait for asynchronous data (set by the session and its P2P sessions)
 	bool							p2pPublishReady; // true if the p2p publisher is ready
 	bool							p2pPlayReady; // true if the p2p player is ready
 	bool							publishReady; // true if the publisher is ready
 	bool							connectReady; // Ready if we have received the NetStream.Connect.Success event
-	bool							dataAvailable; // true if there is asynchronous data available
 
 protected:
 	
@@ -201,6 +225,9 @@ private:
 	std::string														_peerTxtId; // my peer ID in hex format
 
 	std::unique_ptr<Publisher>										_pPublisher; // Unique publisher used by connection & p2p
+	Mona::UInt32													_audioLifetime; // lifetime of the audio messages published
+	Mona::UInt32													_keyFrameLifetime; // lifetime of the video key frames published
+	Mona::UInt32													_interFrameLifetime; // lifetime of the video inter frames published
 
 	std::shared_ptr<RTMFPWriter>									_pMainWriter; // Main writer for the connection
 	std::shared_ptr<RTMFPWriter>									_pGroupWriter; // Writer for the group requests
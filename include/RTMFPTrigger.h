@@ -24,22 +24,39 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "Mona/Mona.h"
 #include "Mona/Time.h"
 #include "Mona/Exceptions.h"
-
+#include "RTTEstimator.h"
+
+/**************************************************
+RTMFPTrigger is the retransmission timer of a writer
+It raises when the retransmission timeout of the
+connection is elapsed without acknowledgment, then
+the timeout is doubled (exponential backoff) until
+an acknowledgment makes progress
+The times given are the clock of the timer wheel
+*/
 class RTMFPTrigger : public virtual Mona::Object {
 public:
-	RTMFPTrigger(Mona::UInt32 delay = 1000, Mona::UInt8 cycles = 8);
+	RTMFPTrigger(Mona::UInt8 maxBackoff = RTMFP_RTO_MAX_BACKOFF);
 	
-	Mona::UInt16 raise(Mona::Exception& ex);
-	void start();
-	void reset();
-	void stop() { _running = false; }
-	Mona::Int8 cycle() { return _cycle; }
+	// Return true if the timeout (rto * 2^backoff) is elapsed
+	// ex is set if the maximum backoff is reached
+	bool			raise(Mona::Exception& ex, Mona::UInt32 rto, Mona::Int64 now);
+	void			start(Mona::Int64 now);
+	// Acknowledgment received : clear the backoff and restart the timer
+	void			reset(Mona::Int64 now);
+	// Messages repeated : restart the timer but keep the backoff
+	void			restart(Mona::Int64 now) { _time = now; }
+	void			stop() { _running = false; }
+	bool			running() const { return _running; }
+	Mona::UInt8		backoff() { return _backoff; }
+	// Return the time when the timeout will be elapsed (in msec)
+	Mona::Int64		deadline(Mona::UInt32 rto) const { return _time + timeout(rto); }
 private:
-	Mona::Time		_timeElapsed;
-	Mona::Int8		_cycle;
-	Mona::UInt8		_time;
+	// Timeout with the backoff (rto * 2^backoff, limited to RTMFP_RTO_MAX)
+	Mona::UInt32	timeout(Mona::UInt32 rto) const;
+
+	Mona::Int64		_time; // start of the current timeout
+	Mona::UInt8		_backoff; // number of timeouts since the last acknowledgment
 	bool			_running;
-	Mona::UInt32	_delay; // time (in msec) between each attempt
-	Mona::UInt8		_cycles; // number of cycles to attempts before raising an exception
+	Mona::UInt8		_maxBackoff; // number of timeouts before raising an exception
 };
-
@@ -26,6 +26,8 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "RTMFPTrigger.h"
 #include "BandWriter.h"
 #include "RTMFPMessage.h"
+#include "RetransmissionQueue.h"
+#include "WriterScheduler.h"
 #include "FlashWriter.h"
 #include "Mona/Logs.h"
 
@@ -56,8 +58,19 @@ public:
 	const Mona::UInt64	id;
 	const Mona::UInt64	flowId; // ID of the flow associated to
 	const std::string	signature;
+	Mona::UInt8			priority; // class of the messages which are not audio or video (see WriterScheduler::Priority)
+	TimerWheel::Timer	timer; // retransmission timeout and deletion of the writer (raised by the connection, see manage)
 
 	bool				flush() { return flush(true); }
+	// Return the number of messages waiting for the congestion window (not sent yet)
+	Mona::UInt32		waiting() const { return _messages.size(); }
+
+	// Return the class of the next message to send, WriterScheduler::COUNT if there is no message to send (expired messages are deleted)
+	Mona::UInt8			nextPriority();
+	// Send the next message (nextPriority() must have returned a class) and return its size
+	Mona::UInt32		sendMessage();
+	// Return the size that the next message takes in the current packet if it is sent whole (0 if there is no message, see WriterScheduler)
+	Mona::UInt32		packedSize();
 
 	bool				acknowledgment(Mona::Exception& ex, Mona::PacketReader& packet);
 	void				manage(Mona::Exception& ex);
@@ -80,12 +93,14 @@ public:
 	void				clear();
 	void				abort();
 	void				close(Mona::Int32 code=0);
-	bool				consumed() { return _messages.empty() && state() == CLOSED && _closeTime.isElapsed(130000); } // Wait 130s before closing the writer definetly
+	bool				consumed() { return _messages.empty() && state() == CLOSED && _band.timers().now() - _closeTime > 130000; } // Wait 130s before closing the writer definetly
 
 	Mona::UInt64		stage() { return _stage; }
 
 	//bool				writeMedia(MediaType type,Mona::UInt32 time,Mona::PacketReader& packet,const Mona::Parameters& properties);
 	virtual void		writeRaw(const Mona::UInt8* data,Mona::UInt32 size);
+	// Queue the audio or video packet by reference to its payload (unbuffered packets are sent directly)
+	virtual bool		writeSharedMedia(MediaType type, Mona::UInt32 time, const std::shared_ptr<const Mona::Buffer>& pPayload);
 	//bool				writeMember(const Client& client);
 
 	// Ask the server to connect to group, netGroup must be in binary format (32 bytes)
@@ -111,21 +126,28 @@ private:
 	// Complete the message with the final container (header, flags, body and front) and write it
 	void					packMessage(Mona::BinaryWriter& writer,Mona::UInt64 stage,Mona::UInt8 flags,bool header, const RTMFPMessage& message, Mona::UInt32 offset, Mona::UInt16 size);
 	// Write unbuffered data if not null and flush all messages
-	bool					flush(bool full);
+	// paced : if true new messages wait for the congestion window, the pacing tokens and the messages of higher classes of the connection
+	bool					flush(bool full, bool paced=true);
 	// Write again repeatable messages
 	void					raiseMessage();
+	// Return the size to repeat of the fragment, 0 if its message has expired (the fragment is then sent with MESSAGE_ABANDONMENT)
+	Mona::UInt32			repeatSize(RetransmissionQueue::Fragment& fragment, Mona::Int64 now);
+	// Remove the first fragment waiting for acknowledgment, return true if it was the last fragment of its message (deleted)
+	bool					popFragment();
+	// Arm the timer at the retransmission timeout, or at the deletion time if the writer is closed
+	void					schedule();
 	RTMFPMessageBuffered&	createMessage();
 	AMFWriter&				write(AMF::ContentType type,Mona::UInt32 time=0,const Mona::UInt8* data=NULL, Mona::UInt32 size=0);
 
-	RTMFPTrigger				_trigger; // count the number of sended cycles for managing repeated/lost counts
+	RTMFPTrigger				_trigger; // retransmission timer of the repeatable messages (see RTTEstimator)
 	std::deque<RTMFPMessage*>	_messages; // queue of messages to send
 	Mona::UInt64				_stage; // stage (index) of the last message sent
-	std::deque<RTMFPMessage*>	_messagesSent; // queue of messages to send back or consider lost if delay is elapsed
+	RetransmissionQueue			_fragments; // fragments sent to send back or consider lost if delay is elapsed (indexed by stage)
 	Mona::UInt64				_stageAck; // stage of the last message acknowledged by the server
 	Mona::UInt32				_lostCount; // number of lost messages
 	double						_ackCount; // number of acknowleged messages
 	Mona::UInt32				_repeatable; // number of repeatable messages waiting for acknowledgment
 	BandWriter&					_band; // RTMFP connection for sending message
-	Mona::Time					_closeTime; // time since writer has been closed
+	Mona::Int64					_closeTime; // time when the writer has been closed (clock of the timer wheel)
 
 };
@@ -0,0 +1,60 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Mona/Mona.h"
+#include <atomic>
+
+#define RTMFP_RTO_INITIAL			1000 // retransmission timeout before the first round-trip time (in msec)
+#define RTMFP_RTO_MIN				250 // minimum retransmission timeout (in msec)
+#define RTMFP_RTO_MAX				8000 // maximum retransmission timeout, also after backoff (in msec)
+#define RTMFP_RTO_GRANULARITY		50 // clock granularity of the retransmissions (delay of the manage cycle, in msec)
+#define RTMFP_RTO_MAX_BACKOFF		8 // number of timeouts without acknowledgment before giving up
+
+/**************************************************
+RTTEstimator computes the smoothed round-trip time
+of a connection and its retransmission timeout
+(RFC 6298 : SRTT, RTTVAR and RTO = SRTT + 4*RTTVAR)
+Samples come from the echo times, they are always
+related to the packet echoed so, as required by the
+Karn's rule, a retransmission never gives an
+ambiguous sample
+*/
+class RTTEstimator : public virtual Mona::Object {
+public:
+	RTTEstimator() : _srtt(0), _rttvar(0), _rto(RTMFP_RTO_INITIAL) {}
+
+	// Add a round-trip time sample (in msec)
+	void				update(Mona::UInt32 rtt);
+
+	// Smoothed round-trip time (in msec, 0 if no sample have been received)
+	Mona::UInt32		srtt() const { return _srtt; }
+	// Round-trip time variation (in msec)
+	Mona::UInt32		rttvar() const { return _rttvar; }
+	// Retransmission timeout (in msec, without backoff)
+	Mona::UInt32		rto() const { return _rto; }
+
+private:
+	std::atomic<Mona::UInt32>	_srtt;
+	std::atomic<Mona::UInt32>	_rttvar;
+	std::atomic<Mona::UInt32>	_rto;
+};
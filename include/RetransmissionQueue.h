@@ -0,0 +1,99 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Mona/Mona.h"
+#include <vector>
+
+class RTMFPMessage;
+/**************************************************
+RetransmissionQueue is the ring of the fragments
+sent by a writer and not yet acknowledged, indexed
+by their stage (one fragment by stage, stages are
+consecutive)
+Records are contiguous and reused : a cumulative
+acknowledgment pops the front records and a lost
+range is a direct access by stage
+*/
+class RetransmissionQueue : public virtual Mona::Object {
+public:
+	struct Fragment {
+		RTMFPMessage*	pMessage; // message of the fragment (deleted with its last fragment)
+		Mona::UInt32	offset; // position of the fragment in the message
+		Mona::UInt32	size; // size of the fragment
+		Mona::UInt64	sentStage; // last stage of the writer when the fragment was sent (it is repeated only if the receiver has got a later stage)
+		bool			abandoned; // true if the message has expired (the fragment is repeated without content)
+	};
+
+	RetransmissionQueue() : _head(0), _count(0), _firstStage(0) {}
+
+	bool				empty() const { return !_count; }
+	Mona::UInt32		count() const { return (Mona::UInt32)_count; }
+	// First and last stage present (only if not empty)
+	Mona::UInt64		firstStage() const { return _firstStage; }
+	Mona::UInt64		lastStage() const { return _firstStage + _count - 1; }
+
+	bool				has(Mona::UInt64 stage) const { return _count && stage >= _firstStage && (stage - _firstStage) < _count; }
+
+	// Return the fragment of the stage (stage must be present)
+	Fragment&			operator[](Mona::UInt64 stage) { return _fragments[(size_t)((_head + stage - _firstStage) & (_fragments.size() - 1))]; }
+	Fragment&			front() { return _fragments[_head]; }
+
+	// Add the fragment of the next stage (if the queue is empty stage becomes the first stage)
+	Fragment&			add(Mona::UInt64 stage, RTMFPMessage* pMessage, Mona::UInt32 offset, Mona::UInt32 size) {
+		if (!_count)
+			_firstStage = stage;
+		if (_count == _fragments.size())
+			resize(_fragments.empty() ? 64 : (_fragments.size() << 1));
+		Fragment& fragment(_fragments[(_head + _count++) & (_fragments.size() - 1)]);
+		fragment.pMessage = pMessage;
+		fragment.offset = offset;
+		fragment.size = size;
+		fragment.sentStage = stage;
+		fragment.abandoned = false;
+		return fragment;
+	}
+
+	// Remove the first fragment
+	void				pop() {
+		_head = (_head + 1) & (_fragments.size() - 1);
+		++_firstStage;
+		--_count;
+	}
+
+	void				clear() { _head = _count = 0; }
+
+private:
+	// Set the capacity (power of 2) and move the fragments in the stage order
+	void				resize(size_t capacity) {
+		std::vector<Fragment> fragments(capacity);
+		for (size_t i = 0; i < _count; ++i)
+			fragments[i] = _fragments[(_head + i) & (_fragments.size() - 1)];
+		_fragments.swap(fragments);
+		_head = 0;
+	}
+
+	std::vector<Fragment>	_fragments; // fragments by slot (capacity is a power of 2)
+	size_t					_head; // slot of the first fragment
+	size_t					_count; // number of fragments
+	Mona::UInt64			_firstStage; // stage of the first fragment
+};
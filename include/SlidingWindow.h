@@ -0,0 +1,275 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Mona/Mona.h"
+#include <vector>
+#include <memory>
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+/**************************************************
+Bits gives the operations on 64 bits words used by
+the bitmaps (SlidingWindow, fragments maps...)
+*/
+class Bits : virtual Mona::Static {
+public:
+	// Return the number of 0 bits before the first 1 (value must not be 0)
+	static Mona::UInt8	TrailingZeros(Mona::UInt64 value) {
+#if defined(_MSC_VER)
+		unsigned long result;
+		_BitScanForward64(&result, value);
+		return (Mona::UInt8)result;
+#else
+		return (Mona::UInt8)__builtin_ctzll(value);
+#endif
+	}
+
+	// Return the number of 0 bits after the last 1 (value must not be 0)
+	static Mona::UInt8	LeadingZeros(Mona::UInt64 value) {
+#if defined(_MSC_VER)
+		unsigned long result;
+		_BitScanReverse64(&result, value);
+		return (Mona::UInt8)(63 - result);
+#else
+		return (Mona::UInt8)__builtin_clzll(value);
+#endif
+	}
+
+	// Reverse the order of the 64 bits of value
+	static Mona::UInt64	Reverse(Mona::UInt64 value) {
+		value = ((value >> 1) & 0x5555555555555555ULL) | ((value & 0x5555555555555555ULL) << 1);
+		value = ((value >> 2) & 0x3333333333333333ULL) | ((value & 0x3333333333333333ULL) << 2);
+		value = ((value >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((value & 0x0F0F0F0F0F0F0F0FULL) << 4);
+		value = ((value >> 8) & 0x00FF00FF00FF00FFULL) | ((value & 0x00FF00FF00FF00FFULL) << 8);
+		value = ((value >> 16) & 0x0000FFFF0000FFFFULL) | ((value & 0x0000FFFF0000FFFFULL) << 16);
+		return (value >> 32) | (value << 32);
+	}
+
+	// Return the number of bits set
+	static Mona::UInt8	Count(Mona::UInt64 value) {
+#if defined(_MSC_VER)
+		return (Mona::UInt8)__popcnt64(value);
+#else
+		return (Mona::UInt8)__builtin_popcountll(value);
+#endif
+	}
+};
+
+/**************************************************
+SlidingWindow is a ring of items indexed by a
+growing sequence number (fragment id, stage...)
+Lookup, insertion and deletion are O(1), the
+presence of each index is kept in a bitmap and
+items are allocated once by slot then reused
+when the window slides.
+Note: index 0 is reserved (it means "no index")
+*/
+template<typename ItemType>
+class SlidingWindow : public virtual Mona::Object {
+public:
+	SlidingWindow(Mona::UInt32 maxCapacity = 0x100000) : _first(0), _last(0), _count(0), _mask(0), _maxCapacity(maxCapacity) {}
+
+	bool				empty() const { return !_count; }
+	Mona::UInt32		count() const { return _count; }
+	// First and last index present, 0 if the window is empty
+	Mona::UInt64		first() const { return _first; }
+	Mona::UInt64		last() const { return _last; }
+
+	bool				has(Mona::UInt64 index) const {
+		if (!_count || index < _first || index > _last)
+			return false;
+		Mona::UInt64 slot = index & _mask;
+		return ((_bitmap[(size_t)(slot >> 6)] >> (slot & 63)) & 1) != 0;
+	}
+
+	// Return the item at index or NULL if not present
+	ItemType*			get(Mona::UInt64 index) const { return has(index) ? _items[(size_t)(index & _mask)].get() : NULL; }
+
+	// Add the index to the window and return the item to fill (recycled from an old index if possible)
+	// Return NULL if the index is already present or if the window would exceed its maximum capacity
+	ItemType*			add(Mona::UInt64 index) {
+		if (!index)
+			return NULL;
+		if (!_count) {
+			if (_items.empty())
+				resize(64);
+			_first = _last = index;
+		}
+		else {
+			if (has(index))
+				return NULL;
+
+			Mona::UInt64 first = (index < _first) ? index : _first;
+			Mona::UInt64 last = (index > _last) ? index : _last;
+			if (last - first >= _maxCapacity)
+				return NULL;
+			if (last - first > _mask) {
+				Mona::UInt64 capacity = _items.size();
+				while (capacity <= (last - first))
+					capacity <<= 1;
+				resize((size_t)capacity);
+			}
+			_first = first;
+			_last = last;
+		}
+
+		Mona::UInt64 slot = index & _mask;
+		_bitmap[(size_t)(slot >> 6)] |= (1ULL << (slot & 63));
+		++_count;
+		std::unique_ptr<ItemType>& pItem = _items[(size_t)slot];
+		if (!pItem)
+			pItem.reset(new ItemType());
+		return pItem.get();
+	}
+
+	// Return the presence bits of the 64 indexes from index (bit 0) to index + 63 (bit 63)
+	Mona::UInt64		bits(Mona::UInt64 index) const {
+		if (!_count || index > _last || index + 63 < _first)
+			return 0;
+
+		Mona::UInt64 slot = index & _mask;
+		Mona::UInt8 shift = (Mona::UInt8)(slot & 63);
+		size_t word = (size_t)(slot >> 6);
+		Mona::UInt64 result = _bitmap[word] >> shift;
+		if (shift)
+			result |= _bitmap[(word + 1) & (_bitmap.size() - 1)] << (64 - shift);
+
+		// Slots of indexes out of the window can be shared with present indexes
+		if (index < _first)
+			result &= ~0ULL << (_first - index);
+		if (index + 63 > _last)
+			result &= ~0ULL >> (index + 63 - _last);
+		return result;
+	}
+
+	// Remove the index from the window (the item is kept for reuse)
+	void				remove(Mona::UInt64 index) {
+		if (!has(index))
+			return;
+
+		Mona::UInt64 slot = index & _mask;
+		_bitmap[(size_t)(slot >> 6)] &= ~(1ULL << (slot & 63));
+		if (!--_count)
+			_first = _last = 0;
+		else if (index == _first)
+			_first = next(index);
+		else if (index == _last)
+			_last = previous(index);
+	}
+
+	// Remove all the indexes lower than index
+	void				removeBefore(Mona::UInt64 index) {
+		if (!_count || index <= _first)
+			return;
+		if (index > _last) {
+			clear();
+			return;
+		}
+
+		// Clear the bitmap word by word
+		Mona::UInt64 current = _first;
+		while (current < index) {
+			Mona::UInt64 slot = current & _mask;
+			Mona::UInt64 bits = 64 - (slot & 63); // bits available in this word
+			if (bits > index - current)
+				bits = index - current;
+			Mona::UInt64 wordMask = ((bits == 64) ? ~0ULL : ((1ULL << bits) - 1)) << (slot & 63);
+			Mona::UInt64& word = _bitmap[(size_t)(slot >> 6)];
+			_count -= Bits::Count(word & wordMask);
+			word &= ~wordMask;
+			current += bits;
+		}
+		_first = next(index - 1);
+	}
+
+	// Remove all indexes (items are kept for reuse)
+	void				clear() {
+		for (Mona::UInt64& word : _bitmap)
+			word = 0;
+		_first = _last = _count = 0;
+	}
+
+	// Return the first index present after index, 0 if there is no more index
+	Mona::UInt64		next(Mona::UInt64 index) const {
+		if (!_count || index >= _last)
+			return 0;
+		if (index < _first)
+			return _first;
+
+		Mona::UInt64 current = index + 1;
+		while (current <= _last) {
+			Mona::UInt64 slot = current & _mask;
+			Mona::UInt64 word = _bitmap[(size_t)(slot >> 6)] >> (slot & 63);
+			if (word)
+				return current + Bits::TrailingZeros(word);
+			current += 64 - (slot & 63);
+		}
+		return 0;
+	}
+
+	// Return the last index present before index, 0 if there is no previous index
+	Mona::UInt64		previous(Mona::UInt64 index) const {
+		if (!_count || index <= _first)
+			return 0;
+		if (index > _last)
+			return _last;
+
+		Mona::UInt64 current = index - 1;
+		while (current >= _first) {
+			Mona::UInt64 slot = current & _mask;
+			Mona::UInt64 word = _bitmap[(size_t)(slot >> 6)] << (63 - (slot & 63));
+			if (word)
+				return current - Bits::LeadingZeros(word);
+			if (current < (slot & 63) + 1)
+				break;
+			current -= (slot & 63) + 1;
+		}
+		return 0;
+	}
+
+private:
+	// Set the capacity (power of 2) and move the present items to their new slot
+	void				resize(size_t capacity) {
+		std::vector<std::unique_ptr<ItemType>>	items(capacity);
+		std::vector<Mona::UInt64>				bitmap(capacity >> 6, 0);
+		Mona::UInt64							mask = capacity - 1;
+
+		for (Mona::UInt64 index = _first; _count && index; index = next(index)) {
+			Mona::UInt64 slot = index & mask;
+			items[(size_t)slot] = std::move(_items[(size_t)(index & _mask)]);
+			bitmap[(size_t)(slot >> 6)] |= (1ULL << (slot & 63));
+		}
+		_items.swap(items);
+		_bitmap.swap(bitmap);
+		_mask = mask;
+	}
+
+	std::vector<std::unique_ptr<ItemType>>	_items; // items by slot (index & _mask)
+	std::vector<Mona::UInt64>				_bitmap; // presence bit of each slot
+	Mona::UInt64							_first; // first index present
+	Mona::UInt64							_last; // last index present
+	Mona::UInt32							_count; // number of indexes present
+	Mona::UInt64							_mask; // capacity - 1
+	const Mona::UInt32						_maxCapacity; // maximum distance between the first and the last index
+};
@@ -26,6 +26,11 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "Mona/DiffieHellman.h"
 #include "RTMFPConnection.h"
 #include "DefaultConnection.h"
+#include "BatchSocket.h"
+#include "ConnectionsTable.h"
+#include "TimerWheel.h"
+
+#define RTMFP_SWEEP_DELAY		1000 // delay between each deletion of the failed connections (in msec)
 
 namespace SHandlerEvents {
 	// Can be called by a separated thread!
@@ -64,6 +69,35 @@ public:
 	// Return poolbuffers object to allocate buffers
 	const Mona::PoolBuffers&			poolBuffers();
 
+	// Return the timer wheel of the session (connections, writers, flows, waiting peers and NetGroup)
+	const std::shared_ptr<TimerWheel>&	timers() { return _pTimers; }
+
+	// Return the lock of the connections, the reception and the management of the connections, writers and flows are serialized by it
+	// The session takes it (after its own lock) to write in its writers : drain of the publication, commands, function calls and close
+	std::recursive_mutex&				mutex() { return _mutexConnections; }
+
+	// Return the flushes of the connections woken up by the packets received (raised at the end of the reception, see endReception)
+	const std::shared_ptr<TimerWheel>&	flushes() { return _pFlushes; }
+
+	// Enable the batched IO mode (Linux only) : datagrams are received with recvmmsg
+	// and the packets of a manage cycle are sent with sendmmsg
+	bool								enableBatchedIO(Mona::Exception& ex);
+
+	// Send the packet of the sender (in batched mode it is encoded now and sent with the next flush(), or at once if it is an application call)
+	void								send(std::shared_ptr<RTMFPSender>& pSender, Mona::PoolThread*& pThread);
+
+	// Send the packets queued in batched mode (called at the end of each manage cycle)
+	void								flush();
+
+	// Return the local port of the socket
+	Mona::UInt16						port();
+
+	// Rebuild the table of connections (called when the near id of a connection has changed)
+	void								updateConnections();
+
+	// Return the IO counters (system calls and datagrams)
+	void								ioCounters(Mona::UInt64& receiveCalls, Mona::UInt64& packetsReceived, Mona::UInt64& sendCalls, Mona::UInt64& packetsSent);
+
 	// Add a connection to the map
 	// return True if the connection is created
 	bool								addConnection(std::shared_ptr<RTMFPConnection>& pConn, const Mona::SocketAddress& address, FlowManager* session, bool responder, bool p2p);
@@ -71,7 +105,7 @@ public:
 	// Accept all connexions (P2P writer or NetGroup)
 	void								setAcceptAll() { _acceptAll = true; }
 
-	// Called by Invoker every second to manage connection (flush and ping)
+	// Called by Invoker at each cycle to raise the timers due (flush, ping, retransmissions...)
 	void								manage();
 
 	// Close the socket all connections
@@ -108,6 +142,15 @@ private:
 	// Delete the connection with the address given
 	void								deleteConnection(const MAP_ADDRESS2CONNECTION::iterator& itConnection);
 
+	// Send the packet to its connection
+	void								process(Mona::PoolBuffer& pBuffer, const Mona::SocketAddress& address);
+
+	// Send the messages written while processing the packets received (called after each packet, or after each batch in batched IO mode)
+	void								endReception();
+
+	// Build the table of connections from the map and publish it (_mutexConnections must be locked)
+	void								publishConnections();
+
 	// Waiting P2P request
 	struct WaitingPeer : public Mona::Object {
 
@@ -120,14 +163,22 @@ private:
 		Mona::UInt8			attempt; // Counter of connection attempts to the server
 		Mona::Time			lastAttempt; // Last attempt to connect to the server
 		Mona::SocketAddress	hostAddress; // Address of the server (if cleared : it is a direct connection)
+		TimerWheel::Timer	timer; // Next attempt
 	};
+	std::shared_ptr<TimerWheel>				_pTimers; // Timers of the session (shared with the connections, they can be deleted after the handler)
+	std::shared_ptr<TimerWheel>				_pFlushes; // Flushes of the connections woken up between two receptions (the other timers are raised only by the cycle)
+	TimerWheel::Timer						_sweepTimer; // Deletion of the failed connections
 	std::map<std::string, WaitingPeer>		_mapTag2Peer; // map of Tag to P2P waiting request
 
 	MAP_ADDRESS2CONNECTION					_mapAddress2Connection; // map of address to RTMFP connection
 	std::unique_ptr<DefaultConnection>		_pDefaultConnection; // Default connection to send handshake messages
 
-	std::mutex								_mutexConnections; // main mutex for connections (normal or p2p)
+	std::recursive_mutex					_mutexConnections; // main mutex for connections (normal or p2p), serialize the processing of packets, the management and the writes of the session
+	std::shared_ptr<ConnectionsTable>		_pConnectionsTable; // Table of connections read without lock by the reception to find the connection (replaced atomically)
 	std::unique_ptr<Mona::UDPSocket>		_pSocket; // Sending socket established with server
+	std::unique_ptr<BatchSocket>			_pBatchSocket; // Socket used in batched IO mode (replace _pSocket if set)
+	std::atomic<Mona::UInt64>				_receiveCalls; // number of receptions with the default socket
+	std::atomic<Mona::UInt64>				_sendCalls; // number of packets sent with the default socket
 	Invoker*								_pInvoker; // Pointer to the main invoker class (to get poolbuffers)
 	RTMFPSession*							_pMainSession; // Pointer to the main RTMFP session for assocation with new connections
 	bool									_acceptAll; // True if we must accept packets from unknown addresses (P2P publisher or NetGroup)
@@ -137,4 +188,7 @@ private:
 	// Events subscriptions
 	Mona::UDPSocket::OnPacket::Type			onPacket; // Main input event, received on each raw packet
 	Mona::UDPSocket::OnError::Type			onError; // Main input event, received on socket error
+	BatchSocket::OnPacket::Type				onBatchPacket; // Input event in batched IO mode
+	BatchSocket::OnBatchEnd::Type			onBatchEnd; // Called after each batch of input packets to send the answers
+	BatchSocket::OnError::Type				onBatchError;
 };
\ No newline at end of file
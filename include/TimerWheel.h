@@ -0,0 +1,134 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Mona/Mona.h"
+#include <functional>
+#include <atomic>
+#include <mutex>
+
+#define RTMFP_TIMER_RESOLUTION		10 // duration of a slot of the first level (in msec)
+#define RTMFP_TIMER_SLOTS			64 // number of slots by level (power of 2)
+#define RTMFP_TIMER_SLOT_BITS		6 // log2(RTMFP_TIMER_SLOTS)
+#define RTMFP_TIMER_LEVELS			4 // number of levels (64^4 slots of 10ms, ~ 46h, later timers are placed again at each turn)
+
+/**************************************************
+TimerWheel raises the timers of the objects of a
+session (writers, flows, connections, NetGroup...)
+only when they are due, so the idle objects cost
+nothing at each manage cycle.
+It is a hierarchical wheel : each level is a ring of
+slots covering 64 times the duration of the previous
+level, arming and cancelling a timer are O(1) and the
+timers are moved to the lower level when their slot
+is reached.
+The clock is read once by cycle (see raise) and given
+to the callbacks, the objects read it with now() rather
+than the system clock (it is also updated for each
+packet received, see update).
+Timers can be armed from any thread, the callbacks
+are called by the thread calling raise(), without the
+lock of the wheel so they can arm timers again or
+delete their own timer.
+*/
+class TimerWheel : public virtual Mona::Object {
+public:
+	class Timer;
+private:
+	// Intrusive list of timers (a slot or the timers due)
+	struct List {
+		List() : pFirst(NULL), pLast(NULL) {}
+
+		Timer*	pFirst;
+		Timer*	pLast;
+	};
+public:
+	/**************************************************
+	Timer is an intrusive item of the wheel, it is
+	disarmed when deleted
+	*/
+	class Timer : public virtual Mona::Object {
+		friend class TimerWheel;
+	public:
+		typedef std::function<void(Mona::Int64 now)> OnTimer;
+
+		Timer(const OnTimer& onTimer = nullptr) : onTimer(onTimer), _pWheel(NULL), _pList(NULL), _pPrevious(NULL), _pNext(NULL), _deadline(0) {}
+		virtual ~Timer() { if (_pWheel) _pWheel->cancel(*this); }
+
+		// Return true if the timer is armed
+		bool			scheduled() const { return _pWheel != NULL; }
+		// Time when the timer will be raised (in msec, 0 if not armed)
+		Mona::Int64		deadline() const { return _deadline; }
+
+		OnTimer			onTimer; // callback called with the clock of the cycle when the deadline is reached (the timer is disarmed before)
+	private:
+		TimerWheel*		_pWheel; // wheel where the timer is armed
+		List*			_pList; // slot of the timer
+		Timer*			_pPrevious;
+		Timer*			_pNext;
+		Mona::Int64		_deadline;
+	};
+
+	TimerWheel();
+	virtual ~TimerWheel();
+
+	// Clock of the current cycle (in msec, updated by raise)
+	Mona::Int64		now() const { return _now; }
+
+	// Number of timers armed
+	Mona::UInt32	count() const { return _count; }
+
+	// Arm (or arm again) the timer at deadline (in msec)
+	// A deadline already reached raises the timer in the current cycle if it is called by a callback, otherwise in the next one
+	void			set(Timer& timer, Mona::Int64 deadline);
+
+	// Arm the timer at deadline unless it is already armed before
+	void			anticipate(Timer& timer, Mona::Int64 deadline);
+
+	// Disarm the timer
+	void			cancel(Timer& timer);
+
+	// Update the clock and call the timers due, return the number of timers raised
+	Mona::UInt32	raise(Mona::Int64 now);
+
+	// Update the clock without raising the timers (packet received between two cycles), the timers due are raised by the next cycle
+	void			update(Mona::Int64 now) { if (now > _now) _now = now; }
+
+private:
+	// Arm the timer (_mutex must be locked)
+	void			arm(Timer& timer, Mona::Int64 deadline);
+	// Insert the timer in its slot, not before minTick (_mutex must be locked)
+	void			insert(Timer& timer, Mona::UInt64 minTick);
+	// Remove the timer from its slot (_mutex must be locked)
+	void			remove(Timer& timer);
+	// Move the timers of a slot of an upper level to their new slot (_mutex must be locked)
+	void			cascade(List& slot);
+
+	static void		Push(List& list, Timer& timer);
+
+	std::mutex					_mutex;
+	List						_slots[RTMFP_TIMER_LEVELS][RTMFP_TIMER_SLOTS]; // rings of slots by level
+	List						_due; // timers to raise in the current cycle
+	Mona::UInt64				_tick; // last tick processed (clock / RTMFP_TIMER_RESOLUTION)
+	std::atomic<Mona::Int64>	_now; // clock of the current cycle
+	std::atomic<Mona::UInt32>	_count; // number of timers armed
+};
@@ -0,0 +1,88 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Mona/Mona.h"
+#include "CongestionController.h"
+#include <vector>
+#include <map>
+
+#define RTMFP_SCHEDULER_QUANTUM		RTMFP_MAX_PACKET_SIZE // bytes credited to a class by weight unit at each round
+
+class RTMFPWriter;
+class BandWriter;
+/**************************************************
+WriterScheduler chooses the order of the new messages
+of the writers of a connection when they can't all be
+sent (congestion window full) :
+- messages are sent by priority class, so audio is
+not waiting behind video frames,
+- each class is credited at each round of a quantum
+weighted by its priority (deficit round robin), so
+the lower classes are slowed down but never blocked,
+- writers of a same class are served in turn.
+Messages of the different writers are packed in the
+same packets, a writer continues its packet only if it
+was the last one to write (see canWriteFollowing).
+When the next message doesn't fit whole in the end of
+the current packet, the largest message of the other
+writers which fits is sent before (the packet leaves
+at once, so the first message is not delayed and is
+not fragmented for a few bytes)
+*/
+class WriterScheduler : public virtual Mona::Object {
+public:
+	// Priority classes of the messages, the first ones are sent first
+	enum Priority {
+		CONTROL = 0, // commands and responses (NetConnection, NetStream, NetGroup reports)
+		AUDIO,
+		KEYFRAME, // video key frames and codec infos
+		INTERFRAME, // other video frames
+		FRAGMENT, // NetGroup media fragments
+		COUNT
+	};
+
+	WriterScheduler();
+
+	// Return true if a writer can send now a new message of this class
+	// False if a message of a higher class is waiting or if the congestion window is full (the message will wait for the scheduler)
+	bool				canSend(Mona::UInt8 priority, CongestionController& congestion);
+
+	// Send the new messages of the writers by priority while the congestion controller of the connection lets them go
+	void				flush(std::map<Mona::UInt64, std::shared_ptr<RTMFPWriter>>& writers, BandWriter& band);
+
+	// Return true if messages are still waiting for the congestion window after the last flush
+	bool				waiting() const { return _backlog < COUNT; }
+
+private:
+	// Add the writer to the queue of its next message class
+	void				push(RTMFPWriter& writer);
+	// Move the writer which has sent a message to the queue of its next message class (index is its position in the queue of priority)
+	void				requeue(RTMFPWriter& writer, Mona::UInt8 priority, size_t index, size_t& cursor);
+	// Send the largest message of the writers which fits whole in the size available, return false if there is none
+	bool				pack(Mona::UInt32 available, size_t* cursors);
+
+	std::vector<RTMFPWriter*>	_queues[COUNT]; // writers waiting by class of their next message (reused at each flush)
+	Mona::Int32					_deficits[COUNT]; // bytes that each class can still send in the current round
+	Mona::UInt64				_lastWriters[COUNT]; // id of the last writer served by class (to begin the next flush with the next one)
+	Mona::UInt8					_backlog; // highest class waiting for the scheduler, COUNT if no message is waiting
+};
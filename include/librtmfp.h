@@ -51,8 +51,44 @@ LIBRTMFP_API typedef struct RTMFPConfig {
 	void	(*pOnSocketError)(const char*); // Socket Error callback
 	void	(*pOnStatusEvent)(const char*, const char*); // RTMFP Status Event callback
 	void	(*pOnMedia)(const char *, const char*, unsigned int, const char*, unsigned int, int); // In synchronous read mode this callback is called when receiving data
+	char	isBatchedIO; // False by default, if True (Linux only) the packets are received with recvmmsg and sent with sendmmsg once by manage cycle
+	unsigned int	ackDelay; // 50 by default, it is the maximum time (in msec) to delay an acknowledgment without lost packets (0 to acknowledge each packet immediately)
+	unsigned int	ackPackets; // 2 by default, it is the number of packets received before sending an acknowledgment immediately
+	unsigned int	audioLifetime; // 2000 by default, it is the time (in msec) after which a published audio packet is abandoned rather than repeated (0 to repeat it until it is acknowledged)
+	unsigned int	keyFrameLifetime; // 4000 by default, it is the time (in msec) after which a published video key frame is abandoned rather than repeated (0 to repeat it until it is acknowledged)
+	unsigned int	interFrameLifetime; // 1000 by default, it is the time (in msec) after which a published video inter frame is abandoned rather than repeated (0 to repeat it until it is acknowledged)
 } RTMFPConfig;
 
+LIBRTMFP_API typedef struct RTMFPStatistics {
+	unsigned long long	receiveCalls; // number of system calls used to receive datagrams
+	unsigned long long	packetsReceived; // number of datagrams received
+	unsigned long long	sendCalls; // number of system calls used to send datagrams
+	unsigned long long	packetsSent; // number of datagrams sent
+	unsigned int		congestionWindow; // congestion window of the server connection (in bytes)
+	unsigned int		bytesInFlight; // bytes sent to the server and not yet acknowledged
+	unsigned int		pacingRate; // pacing rate of the server connection (in bytes/sec)
+	unsigned int		rtt; // smoothed round-trip time of the server connection (in msec)
+	unsigned int		rttVariation; // round-trip time variation of the server connection (in msec)
+	unsigned int		rto; // retransmission timeout of the server connection (in msec)
+	unsigned long long	acksSaved; // number of acknowledgment packets saved by delaying them (server and peers)
+	unsigned int		reorderBytes; // size of the fragments received out of order and waiting for the missing ones (server and peers, in bytes)
+	unsigned int		reorderDepth; // maximum distance between a missing stage and a fragment received out of order (server and peers, in stages)
+	unsigned long long	expiredBytes; // bytes of published media abandoned because their lifetime has expired (server and peers)
+	unsigned long long	droppedFrames; // media frames received and dropped because the read buffer was full, the video is dropped until the next key frame (server and peers)
+	unsigned long long	poolAllocations; // number of messages and AMF writers allocated by the object pools (process-wide)
+	unsigned long long	poolHits; // number of these allocations which have reused the memory of a deleted object (process-wide)
+	unsigned int		poolPeak; // maximum number of pooled objects allocated at the same time, seen by the calls to RTMFP_GetStatistics (process-wide)
+	unsigned int		packetFill; // mean fill ratio of the packets sent (server and peers, in percent of the maximum packet size)
+	unsigned int		packetFillUnpacked; // mean fill ratio that the same data would have had if each writer had sent its packet once finished to write, to compare with packetFill (server and peers, in percent)
+} RTMFPStatistics;
+
+LIBRTMFP_API typedef struct RTMFPFrame {
+	unsigned char		type; // 8 for audio, 9 for video
+	unsigned int		time; // timestamp of the frame (in msec)
+	const char*			data; // payload of the frame, as the body of an FLV tag (codec header + data)
+	unsigned int		size; // size of the payload (in bytes)
+} RTMFPFrame;
+
 // This function MUST be called before any other
 // Initialize the RTMFP parameters with default values
 LIBRTMFP_API void RTMFP_Init(RTMFPConfig*, RTMFPGroupConfig*);
@@ -97,16 +133,43 @@ LIBRTMFP_API void RTMFP_Close(unsigned int RTMFPcontext);
 // return : the number of bytes read (always less or equal than size) or -1 if an error occurs
 LIBRTMFP_API int RTMFP_Read(const char* peerId, unsigned int RTMFPcontext, char *buf, unsigned int size);
 
-// Write size bytes of data into the current connexion
-// return the number of bytes used
+// Read at most count frames from the current connexion without FLV framing (Asynchronous read, same waiting as RTMFP_Read)
+// peerId : the id of the peer or an empty string
+// The data of the frames is owned by the library, it is valid until RTMFP_ReleaseFrames or the next call to RTMFP_ReadFrames
+// return : the number of frames read (always less or equal than count) or -1 if an error occurs
+LIBRTMFP_API int RTMFP_ReadFrames(const char* peerId, unsigned int RTMFPcontext, RTMFPFrame* frames, unsigned int count);
+
+// Release the frames returned by RTMFP_ReadFrames (their space can be reused by the next frames received)
+LIBRTMFP_API void RTMFP_ReleaseFrames(const char* peerId, unsigned int RTMFPcontext);
+
+// Write size bytes of data into the current connexion (the complete FLV tags are queued, it never waits for the network)
+// return the number of bytes used or -1 if an error occurs, 0 means that the data must be written again later (publication queue full because
+// the network is slower than the application, stream not published yet or no complete FLV tag in buf)
 LIBRTMFP_API int RTMFP_Write(unsigned int RTMFPcontext, const char *buf, int size);
 
+// Write an audio (type 8) or video (type 9) frame into the current connexion, without FLV framing (it never waits for the network)
+// return 1 if the frame is queued, 0 if the publication queue is full (try again later) or -1 if an error occurs
+LIBRTMFP_API int RTMFP_WriteFrame(unsigned int RTMFPcontext, unsigned char type, unsigned int time, const char* data, unsigned int size);
+
+// Write count frames into the current connexion (see RTMFP_WriteFrame)
+// return the number of frames queued (the next ones don't fit in the publication queue or the next one is invalid)
+// or -1 if an error occurs on the first frame
+LIBRTMFP_API int RTMFP_WriteFrames(unsigned int RTMFPcontext, const RTMFPFrame* frames, unsigned int count);
+
+// Retrieve the statistics of the connection (counters since the connection)
+// return 1 if the statistics are filled, 0 otherwise
+LIBRTMFP_API int RTMFP_GetStatistics(unsigned int RTMFPcontext, RTMFPStatistics* statistics);
+
 // Call a function of a server, peer or NetGroup
 // param peerId If set to 0 the call we be done to the server, if set to "all" to all the peers of a NetGroup, and to a peer otherwise
 // return 1 if the call succeed, 0 otherwise
 // TODO: add callback
 LIBRTMFP_API unsigned int RTMFP_CallFunction(unsigned int RTMFPcontext, const char* function, int nbArgs, const char** args, const char* peerId);
 
+// Set the maximum number of threads managing the connections (1 by default, RTMFP_Init() must have been called)
+// Each new connection is placed on the thread having the fewest connections, a new thread is started if they all have one
+LIBRTMFP_API void RTMFP_SetManagerThreads(unsigned int threads);
+
 // Set log callback
 LIBRTMFP_API void RTMFP_LogSetCallback(void (* onLog)(unsigned int, int, const char*, long, const char*));
 
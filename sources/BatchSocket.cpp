@@ -0,0 +1,249 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BatchSocket.h"
+#include "Mona/Logs.h"
+#if defined(__linux__)
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <poll.h>
+	#include <unistd.h>
+	#include <errno.h>
+	#include <string.h>
+#endif
+
+using namespace Mona;
+using namespace std;
+
+#if defined(__linux__)
+// Convert a Mona address to an IPv6 socket address (IPv4 addresses are mapped : ::ffff:a.b.c.d)
+static void ToSockAddr(const SocketAddress& address, sockaddr_in6& addr) {
+	memset(&addr, 0, sizeof(addr));
+	addr.sin6_family = AF_INET6;
+	addr.sin6_port = htons(address.port());
+	const IPAddress& host = address.host();
+	if (host.family() == IPAddress::IPv6)
+		memcpy(&addr.sin6_addr, host.addr(), sizeof(in6_addr));
+	else {
+		addr.sin6_addr.s6_addr[10] = addr.sin6_addr.s6_addr[11] = 0xFF;
+		memcpy(addr.sin6_addr.s6_addr + 12, host.addr(), sizeof(in_addr));
+	}
+}
+
+// Convert an IPv6 socket address to a Mona address (mapped addresses are converted to IPv4)
+static void FromSockAddr(const sockaddr_in6& addr, SocketAddress& address) {
+	IPAddress host;
+	if (IN6_IS_ADDR_V4MAPPED(&addr.sin6_addr)) {
+		in_addr addrV4;
+		memcpy(&addrV4, addr.sin6_addr.s6_addr + 12, sizeof(in_addr));
+		host.set(addrV4);
+	}
+	else
+		host.set(addr.sin6_addr);
+	address.set(host, ntohs(addr.sin6_port));
+}
+#endif
+
+BatchSocket::BatchSocket(const PoolBuffers& poolBuffers) : Startable("BatchSocket"), _poolBuffers(poolBuffers), _socket(-1), _port(0), _stopping(false),
+	receiveCalls(0), packetsReceived(0), sendCalls(0), packetsSent(0) {
+	for (int i = 0; i < RTMFP_BATCH_SIZE; ++i)
+		_receiveBuffers.emplace_back(new PoolBuffer(_poolBuffers));
+}
+
+BatchSocket::~BatchSocket() {
+	close();
+}
+
+bool BatchSocket::open(Exception& ex) {
+#if defined(__linux__)
+	if (_socket >= 0)
+		return true;
+
+	// Dual stack socket (IPv4 and IPv6)
+	_socket = ::socket(AF_INET6, SOCK_DGRAM, 0);
+	if (_socket < 0) {
+		ex.set(Exception::NETWORK, "Unable to create the batch socket, ", strerror(errno));
+		return false;
+	}
+	int value(0);
+	setsockopt(_socket, IPPROTO_IPV6, IPV6_V6ONLY, &value, sizeof(value));
+
+	sockaddr_in6 addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin6_family = AF_INET6;
+	socklen_t size(sizeof(addr));
+	if (::bind(_socket, (sockaddr*)&addr, size) < 0 || getsockname(_socket, (sockaddr*)&addr, &size) < 0) {
+		ex.set(Exception::NETWORK, "Unable to bind the batch socket, ", strerror(errno));
+		::close(_socket);
+		_socket = -1;
+		return false;
+	}
+	_port = ntohs(addr.sin6_port);
+
+	_stopping = false;
+	if (!Startable::start(ex, Startable::PRIORITY_HIGH)) {
+		::close(_socket);
+		_socket = -1;
+		return false;
+	}
+	DEBUG("Batch socket opened on port ", _port)
+	return true;
+#else
+	ex.set(Exception::APPLICATION, "Batched IO is only available on Linux");
+	return false;
+#endif
+}
+
+void BatchSocket::close() {
+#if defined(__linux__)
+	if (_socket < 0)
+		return;
+
+	_stopping = true;
+	Startable::stop(); // wait the end of the receiving thread
+	::close(_socket);
+	_socket = -1;
+	_port = 0;
+
+	lock_guard<mutex> lock(_mutexSend);
+	_sendQueue.clear();
+#endif
+}
+
+void BatchSocket::send(const shared_ptr<RTMFPSender>& pSender) {
+	lock_guard<mutex> lock(_mutexSend);
+	_sendQueue.emplace_back(pSender);
+}
+
+void BatchSocket::flush() {
+#if defined(__linux__)
+	if (_socket < 0)
+		return;
+
+	lock_guard<mutex> lockFlush(_mutexFlush);
+	{
+		lock_guard<mutex> lock(_mutexSend);
+		if (_sendQueue.empty())
+			return;
+		_sending.swap(_sendQueue);
+	}
+
+	mmsghdr		messages[RTMFP_BATCH_SIZE];
+	iovec		buffers[RTMFP_BATCH_SIZE];
+	sockaddr_in6 addresses[RTMFP_BATCH_SIZE];
+
+	size_t index = 0;
+	while (index < _sending.size()) {
+		// Prepare the next batch
+		UInt32 count = 0;
+		for (; count < RTMFP_BATCH_SIZE && (index + count) < _sending.size(); ++count) {
+			RTMFPSender& sender(*_sending[index + count]);
+			ToSockAddr(sender.address, addresses[count]);
+			buffers[count].iov_base = (void*)sender.packet.data();
+			buffers[count].iov_len = sender.packet.size();
+			memset(&messages[count], 0, sizeof(mmsghdr));
+			messages[count].msg_hdr.msg_name = &addresses[count];
+			messages[count].msg_hdr.msg_namelen = sizeof(sockaddr_in6);
+			messages[count].msg_hdr.msg_iov = &buffers[count];
+			messages[count].msg_hdr.msg_iovlen = 1;
+		}
+
+		int sent = sendmmsg(_socket, messages, count, 0);
+		++sendCalls;
+		if (sent <= 0) {
+			if (errno == EINTR)
+				continue;
+			// The first packet has failed (unreachable address, timeout of the blocking socket...), skip only this one
+			Exception ex;
+			ex.set(Exception::NETWORK, "Unable to send packet to ", _sending[index]->address.toString(), ", ", strerror(errno));
+			OnError::raise(ex);
+			++index;
+			continue;
+		}
+		packetsSent += sent;
+		index += sent; // (if not all packets have been sent we continue from the first unsent)
+	}
+	_sending.clear();
+#endif
+}
+
+void BatchSocket::run(Exception& ex) {
+#if defined(__linux__)
+	mmsghdr		messages[RTMFP_BATCH_SIZE];
+	iovec		buffers[RTMFP_BATCH_SIZE];
+	sockaddr_in6 addresses[RTMFP_BATCH_SIZE];
+	SocketAddress address;
+
+	pollfd descriptor;
+	descriptor.fd = _socket;
+	descriptor.events = POLLIN;
+	while (!_stopping) {
+		int result = poll(&descriptor, 1, RTMFP_BATCH_TIMEOUT);
+		if (result <= 0) {
+			if (result < 0 && errno != EINTR) {
+				ex.set(Exception::NETWORK, "Batch socket poll error, ", strerror(errno));
+				OnError::raise(ex);
+				break;
+			}
+			continue;
+		}
+
+		// Prepare the pooled buffers
+		for (int i = 0; i < RTMFP_BATCH_SIZE; ++i) {
+			PoolBuffer& pBuffer(*_receiveBuffers[i]);
+			pBuffer->resize(RTMFP_RECEIVE_SIZE, false);
+			buffers[i].iov_base = pBuffer->data();
+			buffers[i].iov_len = RTMFP_RECEIVE_SIZE;
+			memset(&messages[i], 0, sizeof(mmsghdr));
+			messages[i].msg_hdr.msg_name = &addresses[i];
+			messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in6);
+			messages[i].msg_hdr.msg_iov = &buffers[i];
+			messages[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		// Drain the socket
+		int count = recvmmsg(_socket, messages, RTMFP_BATCH_SIZE, MSG_DONTWAIT, NULL);
+		if (count <= 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				Exception exRecv;
+				exRecv.set(Exception::NETWORK, "Batch socket receive error, ", strerror(errno));
+				OnError::raise(exRecv);
+			}
+			continue;
+		}
+		++receiveCalls;
+		packetsReceived += count;
+
+		for (int i = 0; i < count; ++i) {
+			PoolBuffer& pBuffer(*_receiveBuffers[i]);
+			if (messages[i].msg_hdr.msg_flags & MSG_TRUNC)
+				WARN("Truncated datagram received on batch socket (> ", RTMFP_RECEIVE_SIZE, " bytes), ignored")
+			else {
+				pBuffer->resize(messages[i].msg_len, true);
+				FromSockAddr(addresses[i], address);
+				OnPacket::raise(pBuffer, address);
+			}
+			pBuffer.release(); // give back the buffer to the pool
+		}
+		OnBatchEnd::raise();
+	}
+#endif
+}
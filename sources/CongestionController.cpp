@@ -0,0 +1,100 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "CongestionController.h"
+#include "Mona/Time.h"
+#include "Mona/Logs.h"
+
+using namespace Mona;
+using namespace std;
+
+CongestionController::CongestionController() : _window(RTMFP_CC_INITIAL_WINDOW), _inFlight(0), _rtt(RTMFP_CC_DEFAULT_RTT), _threshold(RTMFP_CC_MAX_WINDOW),
+	_tokens(RTMFP_CC_INITIAL_WINDOW), _lastRefill(Time::Now()), _lastReduction(0) {
+}
+
+void CongestionController::refill() {
+	Int64 now = Time::Now();
+	if (now <= _lastRefill)
+		return;
+
+	double rate = (double)pacingRate() / 1000; // bytes/msec
+	double depth = rate * RTMFP_CC_BURST_DELAY;
+	if (depth < RTMFP_CC_MIN_WINDOW)
+		depth = RTMFP_CC_MIN_WINDOW;
+
+	_tokens += rate * (now - _lastRefill);
+	if (_tokens > depth)
+		_tokens = depth;
+	_lastRefill = now;
+}
+
+bool CongestionController::canSend() {
+	// Always let one message go when nothing is in flight to not block the connection
+	if (!_inFlight)
+		return true;
+	if (_inFlight >= _window)
+		return false;
+	refill();
+	return _tokens > 0;
+}
+
+void CongestionController::onPacketSent(UInt32 size) {
+	refill();
+	_tokens -= size; // can be negative, the next packets will wait for the tokens
+	if (_tokens < -(double)RTMFP_CC_MIN_WINDOW)
+		_tokens = -(double)RTMFP_CC_MIN_WINDOW;
+}
+
+void CongestionController::removeInFlight(UInt32 size) {
+	UInt32 inFlight = _inFlight;
+	_inFlight = (size > inFlight) ? 0 : inFlight - size;
+}
+
+void CongestionController::onDataAcknowledged(UInt32 size) {
+	removeInFlight(size);
+
+	UInt32 window = _window;
+	if (window < _threshold) // slow start : +1 byte by byte acknowledged
+		window += size;
+	else // congestion avoidance : +1 packet by window acknowledged
+		window += (UInt32)(((UInt64)RTMFP_MAX_PACKET_SIZE * size) / window);
+	_window = (window > RTMFP_CC_MAX_WINDOW) ? RTMFP_CC_MAX_WINDOW : window;
+}
+
+void CongestionController::onLoss() {
+	// Only one reduction by round-trip (the losses of a same window are one congestion event)
+	Int64 now = Time::Now();
+	if ((now - _lastReduction) < _rtt)
+		return;
+	_lastReduction = now;
+
+	UInt32 window = _window / 2;
+	_threshold = _window = (window < RTMFP_CC_MIN_WINDOW) ? RTMFP_CC_MIN_WINDOW : window;
+	DEBUG("Congestion detected, window reduced to ", _window, " bytes")
+}
+
+void CongestionController::onTimeout() {
+	UInt32 threshold = _window / 2;
+	_threshold = (threshold < RTMFP_CC_MIN_WINDOW) ? RTMFP_CC_MIN_WINDOW : threshold;
+	_window = RTMFP_CC_MIN_WINDOW;
+	_lastReduction = Time::Now();
+}
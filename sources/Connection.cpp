@@ -27,11 +27,13 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 using namespace Mona;
 using namespace std;
 
-Connection::Connection(SocketHandler* pHandler) : _pParent(pHandler), _status(RTMFP::STOPPED), _farId(0), _pThread(NULL), _nextRTMFPWriterId(1), _ping(0), _timeReceived(0),
+Connection::Connection(SocketHandler* pHandler) : _pParent(pHandler), _pTimers(pHandler->timers()), _pFlushes(pHandler->flushes()), _status(RTMFP::STOPPED), _farId(0), _pThread(NULL), _nextRTMFPWriterId(1), _ping(0), _timeReceived(0), _expiredBytes(0), _packetsSent(0), _bytesSent(0), _flushesDeferred(0), _deferredSize(0),
  _pEncoder(new RTMFPEngine((const Mona::UInt8*)RTMFP_DEFAULT_KEY, RTMFPEngine::ENCRYPT)),
  _pDecoder(new RTMFPEngine((const Mona::UInt8*)RTMFP_DEFAULT_KEY, RTMFPEngine::DECRYPT)),
  _pDefaultDecoder(new RTMFPEngine((const UInt8*)RTMFP_DEFAULT_KEY, RTMFPEngine::DECRYPT)) {
 
+	_timer.onTimer = [this](Int64 now) { manage(); };
+	_flushTimer.onTimer = [this](Int64 now) { flushWriters(); };
 }
 
 Connection::~Connection() {
@@ -55,25 +57,16 @@ void Connection::close(bool abrupt) {
 		if (!abrupt)
 			it.second->close();
 	}
+	flush(); // last messages of the writers (they are not sent after the close)
 
 	_status = abrupt? RTMFP::FAILED : RTMFP::NEAR_CLOSED;
 	_closeTime.update();
 }
 
-void Connection::process(PoolBuffer& pBuffer) {
+void Connection::process(PoolBuffer& pBuffer, UInt32 idStream) {
 	if (_status >= RTMFP::NEAR_CLOSED)
 		return;
 
-	// Decode the RTMFP data
-	if (pBuffer->size() < RTMFP_MIN_PACKET_SIZE) {
-		ERROR("Invalid RTMFP packet on connection to ", _address.toString())
-		return;
-	}
-
-	BinaryReader reader(pBuffer.data(), pBuffer.size());
-	UInt32 idStream = RTMFP::Unpack(reader);
-	pBuffer->clip(reader.position());
-
 	// Handshake or session decoder?
 	RTMFPEngine* pDecoder = (idStream == 0) ? _pDefaultDecoder.get() : _pDecoder.get();
 
@@ -106,6 +99,8 @@ void Connection::setPing(UInt16 time, UInt16 timeEcho) {
 	}
 	UInt16 value = (time - timeEcho) * RTMFP_TIMESTAMP_SCALE;
 	_ping = (value == 0 ? 1 : value);
+	_rtt.update(_ping);
+	_congestion.setRTT(_rtt.srtt());
 }
 
 BinaryWriter& Connection::writeMessage(UInt8 type, UInt16 length, RTMFPWriter* pWriter) {
@@ -153,6 +148,8 @@ void Connection::handleAcknowledgment(UInt64 id, Mona::PacketReader& message) {
 		Exception ex;
 		if (!pWriter->acknowledgment(ex, message))
 			WARN(ex.error(), " on connection ", name())
+		if (_pSender)
+			wakeUp(); // send the messages repeated at the next cycle
 	}
 	else
 		WARN("RTMFPWriter ", id, " unfound for acknowledgment on connection ", name())
@@ -170,6 +167,9 @@ void Connection::flush(bool echoTime, UInt8 marker) {
 	if (!_pSender)
 		return;
 	if (_status < RTMFP::NEAR_CLOSED && _pSender->available()) {
+		if (marker != 0x0B)
+			OnFlush::raise(); // piggyback the delayed acknowledgments
+
 		BinaryWriter& packet(_pSender->packet);
 
 		// After 30 sec, send packet without echo time
@@ -196,13 +196,22 @@ void Connection::flush(bool echoTime, UInt8 marker) {
 		if (Logs::GetLevel() >= 7)
 			DUMP("RTMFP", packet.data() + 6, packet.size() - 6, "Response to ", _address.toString(), " (farId : ", _farId, ")")
 
-		Exception ex;
-		_pThread = _pParent->socket().send<RTMFPSender>(ex, _pSender, _pThread);
-
-		if (ex)
-			ERROR("RTMFP flush, ", ex.error());
+		_congestion.onPacketSent(packet.size());
+		++_packetsSent;
+		_bytesSent += packet.size();
+		_pParent->send(_pSender, _pThread);
 	}
 	_pSender.reset();
+	_deferredSize = 0;
+}
+
+void Connection::flushLater() {
+	// Count the packet once by new messages written, as the writers flushed it at once before
+	if (_pSender && _pSender->available() && _pSender->packet.size() > _deferredSize) {
+		++_flushesDeferred;
+		_deferredSize = _pSender->packet.size();
+	}
+	wakeUp();
 }
 
 shared_ptr<RTMFPWriter>& Connection::writer(UInt64 id, shared_ptr<RTMFPWriter>& pWriter) {
@@ -216,6 +225,8 @@ void Connection::initWriter(const shared_ptr<RTMFPWriter>& pWriter) {
 	while (++_nextRTMFPWriterId == 0 || !_flowWriters.emplace(_nextRTMFPWriterId, pWriter).second);
 	(UInt64&)pWriter->id = _nextRTMFPWriterId;
 	pWriter->amf0 = false;
+	RTMFPWriter* pThis(pWriter.get());
+	pWriter->timer.onTimer = [this, pThis](Int64 now) { manageWriter(*pThis); };
 
 	if (!pWriter->signature.empty())
 		DEBUG("New writer ", pWriter->id, " on connection ", name());
@@ -223,34 +234,37 @@ void Connection::initWriter(const shared_ptr<RTMFPWriter>& pWriter) {
 }
 
 void Connection::flushWriters() {
-	// Every 25s : ping
-	if (_lastPing.isElapsed(25000) && connected()) {
-		writeMessage(0x01, 0);
-		flush(false, 0x89);
-		_lastPing.update();
-	}
+	_pFlushes->cancel(_flushTimer); // (flushed by the cycle before the end of the reception)
 
-	// Raise RTMFPWriter
-	auto it = _flowWriters.begin();
-	while (it != _flowWriters.end()) {
-		shared_ptr<RTMFPWriter>& pWriter(it->second);
-		Exception ex;
-		pWriter->manage(ex);
-		if (ex) {
-			/* TODO: if (pWriter->critical) {
-				fail(ex.error());
-				break;
-			}*/
-			continue;
-		}
-		if (pWriter->consumed()) {
-			OnWriterClose::raise(pWriter);
-			DEBUG("Connection ", name(), " - RTMFPWriter ", pWriter->id, " consumed");
-			_flowWriters.erase(it++);
-			continue;
-		}
-		++it;
+	// Send the new messages by priority and flush
+	_scheduler.flush(_flowWriters, *this);
+	flush();
+
+	// Messages are waiting for the congestion window : try again at the next cycle
+	if (_scheduler.waiting())
+		_pTimers->anticipate(_timer, _pTimers->now() + 1);
+}
+
+void Connection::manageWriter(RTMFPWriter& writer) {
+	Exception ex;
+	writer.manage(ex);
+	if (_pSender)
+		wakeUp(); // send the messages repeated in this cycle
+	if (ex || !writer.consumed()) {
+		/* TODO: if (ex && writer.critical) {
+			fail(ex.error());
+			return;
+		}*/
+		return; // (the writer has armed its timer again)
 	}
+
+	auto it = _flowWriters.find(writer.id);
+	if (it == _flowWriters.end() || it->second.get() != &writer)
+		return;
+	shared_ptr<RTMFPWriter> pWriter(it->second); // (deleted at the end of the call with its timer)
+	OnWriterClose::raise(pWriter);
+	DEBUG("Connection ", name(), " - RTMFPWriter ", pWriter->id, " consumed");
+	_flowWriters.erase(it);
 }
 
 shared_ptr<RTMFPWriter> Connection::changeWriter(RTMFPWriter& writer) {
@@ -272,6 +286,16 @@ void Connection::clearWriters() {
 
 void Connection::manage() {
 
+	// Every 25s : ping
+	if (connected()) {
+		if (_lastPing.isElapsed(25000)) {
+			writeMessage(0x01, 0);
+			flush(false, 0x89);
+			_lastPing.update();
+		}
+		_pTimers->anticipate(_timer, _pTimers->now() + 25000 - _lastPing.elapsed());
+	}
+
 	// Flush writers
 	flushWriters();
 }
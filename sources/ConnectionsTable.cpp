@@ -0,0 +1,110 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ConnectionsTable.h"
+#include "RTMFPConnection.h"
+
+using namespace Mona;
+using namespace std;
+
+#define NOT_UNIQUE_ID	0xFFFFFFFF
+
+ConnectionsTable::Key::Key(const SocketAddress& address) : high(0), low(0), port(address.port()) {
+	const IPAddress& host = address.host();
+	UInt8 bytes[16] = { 0 };
+	if (host.family() == IPAddress::IPv6)
+		memcpy(bytes, host.addr(), 16);
+	else {
+		bytes[10] = bytes[11] = 0xFF;
+		memcpy(bytes + 12, host.addr(), 4);
+	}
+	memcpy(&high, bytes, 8);
+	memcpy(&low, bytes + 8, 8);
+}
+
+UInt64 ConnectionsTable::Key::hash() const {
+	// Mix of the words (finalizer of splitmix64)
+	UInt64 value = high ^ (low * 0x9E3779B97F4A7C15ULL) ^ ((UInt64)port << 32);
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+	return value ^ (value >> 31);
+}
+
+static UInt32 HashId(UInt32 id) {
+	UInt32 value = id * 0x9E3779B1;
+	return value ^ (value >> 16);
+}
+
+ConnectionsTable::ConnectionsTable(UInt32 count) : _mask(7) {
+	// Load factor <= 0.5
+	while (_mask < count * 2)
+		_mask = (_mask << 1) | 1;
+	_addressSlots.resize(_mask + 1, 0);
+	_idSlots.resize(_mask + 1, 0);
+	_ids.resize(_mask + 1, 0);
+	_connections.reserve(count);
+	_keys.reserve(count);
+}
+
+void ConnectionsTable::add(const shared_ptr<RTMFPConnection>& pConnection) {
+	_connections.emplace_back(pConnection);
+	_keys.emplace_back(pConnection->address());
+	UInt32 index = (UInt32)_connections.size();
+
+	UInt32 slot = (UInt32)_keys.back().hash() & _mask;
+	while (_addressSlots[slot])
+		slot = (slot + 1) & _mask;
+	_addressSlots[slot] = index;
+
+	UInt32 nearId = pConnection->nearId();
+	if (!nearId)
+		return;
+	slot = HashId(nearId) & _mask;
+	while (_idSlots[slot]) {
+		if (_ids[slot] == nearId) {
+			_idSlots[slot] = NOT_UNIQUE_ID; // several connections with this id (ex: 0x02000000 for initiators), use the address
+			return;
+		}
+		slot = (slot + 1) & _mask;
+	}
+	_idSlots[slot] = index;
+	_ids[slot] = nearId;
+}
+
+const shared_ptr<RTMFPConnection>* ConnectionsTable::find(const Key& key) const {
+	UInt32 slot = (UInt32)key.hash() & _mask;
+	while (UInt32 index = _addressSlots[slot]) {
+		if (_keys[index - 1] == key)
+			return &_connections[index - 1];
+		slot = (slot + 1) & _mask;
+	}
+	return NULL;
+}
+
+const shared_ptr<RTMFPConnection>* ConnectionsTable::find(UInt32 nearId) const {
+	UInt32 slot = HashId(nearId) & _mask;
+	while (UInt32 index = _idSlots[slot]) {
+		if (_ids[slot] == nearId)
+			return (index == NOT_UNIQUE_ID) ? NULL : &_connections[index - 1];
+		slot = (slot + 1) & _mask;
+	}
+	return NULL;
+}
@@ -0,0 +1,68 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "DataSignal.h"
+#if defined(__linux__)
+	#include <linux/futex.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+	#include <time.h>
+#endif
+
+using namespace Mona;
+using namespace std;
+
+void DataSignal::set() {
+	if (_state.load(memory_order_relaxed) == AVAILABLE)
+		return; // already set (fast path)
+
+	if (_state.exchange(AVAILABLE) != WAITING)
+		return; // nobody is sleeping
+
+#if defined(__linux__)
+	syscall(SYS_futex, (UInt32*)&_state, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+	lock_guard<mutex> lock(_mutex);
+	_condition.notify_one();
+#endif
+}
+
+bool DataSignal::wait(UInt32 millisec) {
+	UInt32 state(EMPTY);
+	if (!_state.compare_exchange_strong(state, WAITING) && state == AVAILABLE)
+		return true;
+
+	// Sleep while the state is WAITING
+#if defined(__linux__)
+	timespec timeout;
+	timeout.tv_sec = millisec / 1000;
+	timeout.tv_nsec = (millisec % 1000) * 1000000;
+	syscall(SYS_futex, (UInt32*)&_state, FUTEX_WAIT_PRIVATE, (UInt32)WAITING, &timeout, NULL, 0); // (return immediately if the state has changed)
+#else
+	unique_lock<mutex> lock(_mutex);
+	_condition.wait_for(lock, chrono::milliseconds(millisec), [this]() { return _state.load() != WAITING; });
+#endif
+
+	// Go back to EMPTY if nothing has been received
+	state = WAITING;
+	_state.compare_exchange_strong(state, EMPTY);
+	return state == AVAILABLE || _state.load() == AVAILABLE;
+}
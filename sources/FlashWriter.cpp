@@ -29,10 +29,10 @@ using namespace std;
 using namespace Mona;
 
 
-FlashWriter::FlashWriter(State state,const PoolBuffers& poolBuffers) : poolBuffers(poolBuffers),_callbackHandleOnAbort(0),_callbackHandle(0),amf0(false),reliable(true),_state(state) {
+FlashWriter::FlashWriter(State state,const PoolBuffers& poolBuffers) : poolBuffers(poolBuffers),_callbackHandleOnAbort(0),_callbackHandle(0),amf0(false),reliable(true),lifetime(0),_state(state) {
 }
 
-FlashWriter::FlashWriter(FlashWriter& other) : reliable(other.reliable), poolBuffers(other.poolBuffers),_callbackHandle(other._callbackHandle),_callbackHandleOnAbort(0),amf0(other.amf0) {
+FlashWriter::FlashWriter(FlashWriter& other) : reliable(other.reliable), lifetime(other.lifetime), poolBuffers(other.poolBuffers),_callbackHandle(other._callbackHandle),_callbackHandleOnAbort(0),amf0(other.amf0) {
 	other._callbackHandle = 0;
 }
 
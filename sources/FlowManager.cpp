@@ -28,27 +28,11 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "FlashConnection.h"
 #include "RTMFPFlow.h"
 #include "SocketHandler.h"
+#include "librtmfp.h"
 
 using namespace Mona;
 using namespace std;
 
-FlowManager::RTMFPMediaPacket::RTMFPMediaPacket(const PoolBuffers& poolBuffers, const UInt8* data, UInt32 size, UInt32 time, bool audio) : pBuffer(poolBuffers, size + 15), pos(0) {
-	BinaryWriter writer(pBuffer->data(), size + 15);
-
-	writer.write8(audio ? '\x08' : '\x09');
-	// size on 3 bytes
-	writer.write24(size);
-	// time on 3 bytes
-	writer.write24(time);
-	// unknown 4 bytes set to 0
-	writer.write32(0);
-	// payload
-	writer.write(data, size);
-	// footer
-	writer.write32(11 + size);
-
-}
-
 const char FlowManager::_FlvHeader[] = { 'F', 'L', 'V', 0x01,
 0x05,				/* 0x04 == audio, 0x01 == video */
 0x00, 0x00, 0x00, 0x09,
@@ -56,8 +40,8 @@ const char FlowManager::_FlvHeader[] = { 'F', 'L', 'V', 0x01,
 };
 
 FlowManager::FlowManager(Invoker* invoker, OnSocketError pOnSocketError, OnStatusEvent pOnStatusEvent, OnMediaEvent pOnMediaEvent) :
-	_firstRead(true), _pInvoker(invoker), _firstMedia(true), _timeStart(0), _codecInfosRead(false), _pOnStatusEvent(pOnStatusEvent), _pOnMedia(pOnMediaEvent), _pOnSocketError(pOnSocketError),
-	status(RTMFP::STOPPED), _tag(16, '0'), _sessionId(0), _pListener(NULL), _mainFlowId(0) {
+	_firstRead(true), _framesSize(0), _pMediaRing(NULL), _waitKeyFrame(false), _droppedFrames(0), _pInvoker(invoker), _firstMedia(true), _timeStart(0), _codecInfosRead(false), _pOnStatusEvent(pOnStatusEvent), _pOnMedia(pOnMediaEvent), _pOnSocketError(pOnSocketError),
+	status(RTMFP::STOPPED), _tag(16, '0'), _sessionId(0), _pListener(NULL), _mainFlowId(0), _ackDelay(RTMFP_ACK_DELAY), _ackPackets(RTMFP_ACK_PACKETS), _acksSaved(0), _reorderBytes(0), _reorderDepth(0) {
 	onStatus = [this](const string& code, const string& description, UInt16 streamId, UInt64 flowId, double cbHandler) {
 		_pOnStatusEvent(code.c_str(), description.c_str());
 
@@ -100,8 +84,28 @@ FlowManager::FlowManager(Invoker* invoker, OnSocketError pOnSocketError, OnStatu
 			_pOnMedia(name().c_str(), stream.c_str(), time-_timeStart, (const char*)packet.current(), packet.available(), audio);
 		else { // Asynchronous read
 			{
-				lock_guard<recursive_mutex> lock(_readMutex); // TODO: use the 'stream' parameter
-				_mediaPackets[name()].emplace_back(new RTMFPMediaPacket(_pInvoker->poolBuffers, packet.current(), packet.available(), time - _timeStart, audio));
+				lock_guard<mutex> lock(_writeMutex); // TODO: use the 'stream' parameter
+				MediaRing* pRing = _pMediaRing.load(memory_order_acquire);
+				if (!pRing)
+					_pMediaRing.store(pRing = new MediaRing(RTMFP_MEDIA_RING_SIZE), memory_order_release);
+				bool keyFrame(!audio && RTMFP::IsKeyFrame(packet.current(), packet.available()));
+				if (!audio && _waitKeyFrame && !keyFrame) {
+					++_droppedFrames; // the decoder can't use the next inter frames without the one dropped
+					return;
+				}
+				if (!pRing->writeTag(audio ? '\x08' : '\x09', time - _timeStart, packet.current(), packet.available())) {
+					++_droppedFrames;
+					if (audio)
+						WARN("Audio packet of ", packet.available(), " bytes dropped, the read buffer of ", name(), " is full (", pRing->capacity(), " bytes)")
+					else {
+						if (!_waitKeyFrame)
+							WARN("Video packet of ", packet.available(), " bytes dropped, the read buffer of ", name(), " is full (", pRing->capacity(), " bytes), waiting for the next key frame")
+						_waitKeyFrame = true;
+					}
+					return;
+				}
+				if (keyFrame)
+					_waitKeyFrame = false;
 			}
 			handleDataAvailable(true);
 		}
@@ -119,6 +123,18 @@ FlowManager::FlowManager(Invoker* invoker, OnSocketError pOnSocketError, OnStatu
 	onWriterFailed = [this](shared_ptr<RTMFPWriter>& pWriter) {
 		handleWriterFailed(pWriter);
 	};
+	_ackTimer.onTimer = [this](Int64 now) {
+		--_acksSaved; // one packet has been needed
+		if (_pConnection)
+			_pConnection->flush();
+	};
+	onFlush = [this]() {
+		// Complete the packet with the delayed acknowledgments which fit in
+		for (auto& it : _flows) {
+			if (it.second->ackDelayed() && _pConnection)
+				it.second->writeAck(_pConnection->availableToWrite());
+		}
+	};
 
 	Util::Random((UInt8*)_tag.data(), 16); // random serie of 16 bytes
 
@@ -138,8 +154,7 @@ FlowManager::~FlowManager() {
 	close(true);
 
 	// delete media packets
-	lock_guard<recursive_mutex> lock(_readMutex);
-	_mediaPackets.clear();
+	delete _pMediaRing.exchange(NULL);
 
 	if (_pMainStream) {
 		_pMainStream->OnStatus::unsubscribe(onStatus);
@@ -181,6 +196,7 @@ void FlowManager::subscribe(shared_ptr<RTMFPConnection>& pConnection) {
 	pConnection->OnNewWriter::subscribe(onNewWriter);
 	pConnection->OnWriterFailed::subscribe(onWriterFailed);
 	pConnection->OnWriterClose::subscribe(onWriterClose);
+	pConnection->OnFlush::subscribe(onFlush);
 	_mapConnections.emplace(pConnection->address(), pConnection);
 }
 
@@ -205,6 +221,7 @@ void FlowManager::unsubscribeConnection(shared_ptr<RTMFPConnection>& pConnection
 	pConnection->OnNewWriter::unsubscribe(onNewWriter);
 	pConnection->OnWriterFailed::unsubscribe(onWriterFailed);
 	pConnection->OnWriterClose::unsubscribe(onWriterClose);
+	pConnection->OnFlush::unsubscribe(onFlush);
 }
 
 bool FlowManager::readAsync(UInt8* buf, UInt32 size, int& nbRead) {
@@ -212,45 +229,75 @@ bool FlowManager::readAsync(UInt8* buf, UInt32 size, int& nbRead) {
 		ERROR("Parameter nbRead must equal zero in readAsync()")
 	else if (status == RTMFP::CONNECTED) {
 
-		bool available = false;
-		lock_guard<recursive_mutex> lock(_readMutex);
-		if (!_mediaPackets[name()].empty()) {
+		MediaRing* pRing = _pMediaRing.load(memory_order_acquire);
+		if (pRing && !pRing->empty()) {
 			// First read => send header
 			if (_firstRead && size > sizeof(_FlvHeader)) { // TODO: make a real context with a recorded position
 				memcpy(buf, _FlvHeader, sizeof(_FlvHeader));
 				_firstRead = false;
+				buf += sizeof(_FlvHeader);
 				size -= sizeof(_FlvHeader);
 				nbRead += sizeof(_FlvHeader);
 			}
+			nbRead += pRing->read(buf, size);
+		}
+		return true;
+	} 
 
-			UInt32 bufferSize = 0, toRead = 0;
-			auto& queue = _mediaPackets[name()];
-			while (!queue.empty() && (nbRead < size)) {
-
-				// Read next packet
-				std::shared_ptr<RTMFPMediaPacket>& packet = queue.front();
-				bufferSize = packet->pBuffer.size() - packet->pos;
-				toRead = (bufferSize > (size - nbRead)) ? size - nbRead : bufferSize;
-				memcpy(buf + nbRead, packet->pBuffer.data() + packet->pos, toRead);
-				nbRead += toRead;
-
-				// If packet too big : save position and exit
-				if (bufferSize > toRead) {
-					packet->pos += toRead;
-					break;
-				}
-				queue.pop_front();
+	return false;
+}
+
+bool FlowManager::readFrames(RTMFPFrame* frames, UInt32 count, int& nbFrames) {
+	if (nbFrames != 0)
+		ERROR("Parameter nbFrames must equal zero in readFrames()")
+	else if (status == RTMFP::CONNECTED) {
+
+		MediaRing* pRing = _pMediaRing.load(memory_order_acquire);
+		if (!pRing)
+			return true;
+		releaseFrames();
+
+		// Read the tags in place, only a payload wrapping around the end of the ring is copied (once by call)
+		UInt32 offset(0), size;
+		const UInt8* data;
+		while ((UInt32)nbFrames < count && (data = pRing->span(size, offset))) {
+			UInt8 header[FLV_TAG_HEADER_SIZE];
+			if (size < FLV_TAG_HEADER_SIZE) { // header wrapping around the end of the ring
+				pRing->peek(offset, header, FLV_TAG_HEADER_SIZE);
+				data = header;
 			}
-			available = !queue.empty();
+
+			RTMFPFrame& frame = frames[nbFrames++];
+			BinaryReader reader(data, FLV_TAG_HEADER_SIZE);
+			frame.type = reader.read8();
+			frame.size = reader.read24();
+			frame.time = reader.read24();
+			frame.time |= (UInt32)reader.read8() << 24; // extended time
+			if (size >= FLV_TAG_HEADER_SIZE + frame.size)
+				frame.data = STR data + FLV_TAG_HEADER_SIZE;
+			else {
+				_frameBuffer.resize(frame.size, false);
+				pRing->peek(offset + FLV_TAG_HEADER_SIZE, _frameBuffer.data(), frame.size);
+				frame.data = STR _frameBuffer.data();
 			}
-		if (!available)
-			handleDataAvailable(false); // change the available status
+			offset += FLV_TAG_HEADER_SIZE + frame.size + FLV_TAG_FOOTER_SIZE;
+		}
+		_framesSize = offset;
 		return true;
-	} 
+	}
 
 	return false;
 }
 
+void FlowManager::releaseFrames() {
+	if (!_framesSize)
+		return;
+	MediaRing* pRing = _pMediaRing.load(memory_order_acquire);
+	if (pRing)
+		pRing->consume(_framesSize);
+	_framesSize = 0;
+}
+
 void FlowManager::receive(BinaryReader& reader) {
 
 	// Variables for request (0x10 and 0x11)
@@ -292,6 +339,7 @@ void FlowManager::receive(BinaryReader& reader) {
 			fail("Timeout connection client");
 			else*/
 			_pConnection->writeMessage(0x41, 0);
+			_pConnection->wakeUp();
 			break;
 		case 0x41:
 			_lastKeepAlive.update();
@@ -379,9 +427,16 @@ void FlowManager::receive(BinaryReader& reader) {
 				flags = message.read8();
 
 			// Process request
-			if (pFlow && (status != RTMFP::FAILED))
+			if (pFlow && (status != RTMFP::FAILED)) {
+				UInt32 reorderBytes(pFlow->reorderBytes());
 				pFlow->receive(stage, deltaNAck, message, flags);
 
+				// Update the reordering statistics with the difference
+				_reorderBytes += pFlow->reorderBytes() - reorderBytes;
+				if (pFlow->reorderDepth() > _reorderDepth)
+					_reorderDepth = pFlow->reorderDepth();
+			}
+
 			break;
 		}
 		default:
@@ -395,9 +450,12 @@ void FlowManager::receive(BinaryReader& reader) {
 
 		// Commit RTMFPFlow (pFlow means 0x11 or 0x10 message)
 		if (pFlow && (status != RTMFP::FAILED) && type != 0x11) {
-			pFlow->commit();
-			if (pFlow->consumed())
+			if (!pFlow->commit(_ackDelay ? _ackPackets : 0))
+				++_acksSaved; // delayed, it will be coalesced or sent with the next packet
+			if (pFlow->consumed(_pConnection->timers().now()))
 				removeFlow(pFlow);
+			else
+				scheduleFlow(*pFlow);
 			pFlow = NULL;
 		}
 	}
@@ -436,18 +494,32 @@ RTMFPFlow* FlowManager::createFlow(UInt64 id, const string& signature, UInt64 id
 		return NULL;
 	}
 
+	pFlow->timer.onTimer = [this, pFlow](Int64 now) { manageFlow(*pFlow, now); };
 	return _flows.emplace_hint(it, piecewise_construct, forward_as_tuple(id), forward_as_tuple(pFlow))->second;
 }
 
-void FlowManager::manage() {
+void FlowManager::scheduleFlow(RTMFPFlow& flow) {
+	if (!_pConnection)
+		return; // the session is dying, the flows will be deleted with it
 
-	auto itFlow = _flows.begin();
-	while (itFlow != _flows.end()) {
-		if (itFlow->second->consumed())
-			removeFlow((itFlow++)->second);
-		else
-			++itFlow;
+	TimerWheel& timers(_pConnection->timers());
+	Int64 deadline(flow.deadline(_ackDelay));
+	if (!deadline)
+		timers.cancel(flow.timer);
+	else
+		timers.set(flow.timer, max(deadline, timers.now() + 1));
+}
+
+void FlowManager::manageFlow(RTMFPFlow& flow, Int64 now) {
+	if (flow.consumed(now)) {
+		removeFlow(&flow); // (the timer is deleted with the flow)
+		return;
 	}
+
+	// Send the acknowledgment delayed since too long, the ones of this cycle are sent in the same packet (see _ackTimer)
+	if (_pConnection && flow.ackElapsed(_ackDelay, now) && flow.writeAck())
+		_pConnection->timers().anticipate(_ackTimer, now);
+	scheduleFlow(flow);
 }
 
 void FlowManager::removeFlow(RTMFPFlow* pFlow) {
@@ -463,5 +535,6 @@ void FlowManager::removeFlow(RTMFPFlow* pFlow) {
 	}
 	DEBUG("Session ", name(), " - RTMFPFlow ", pFlow->id, " consumed");
 	_flows.erase(pFlow->id);
+	_reorderBytes -= pFlow->reorderBytes();
 	delete pFlow;
 }
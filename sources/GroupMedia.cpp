@@ -27,12 +27,19 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 using namespace Mona;
 using namespace std;
 
-// Fragment instance
+// Fragment instance (allocated once by slot of the fragments window and reused)
 class MediaPacket : public virtual Object {
 public:
-	MediaPacket(const PoolBuffers& poolBuffers, const UInt8* data, UInt32 size, UInt32 totalSize, UInt32 time, AMF::ContentType mediaType,
-		UInt64 fragmentId, UInt8 groupMarker, UInt8 splitId) : splittedId(splitId), type(mediaType), marker(groupMarker), time(time), pBuffer(poolBuffers, totalSize) {
-		BinaryWriter writer(pBuffer->data(), totalSize);
+	MediaPacket() : splittedId(0), type(AMF::EMPTY), marker(0), time(0), payload(NULL) {}
+
+	// Write the fragment into the buffer (its capacity is kept from the last use)
+	void set(const UInt8* data, UInt32 size, UInt32 totalSize, UInt32 time, AMF::ContentType mediaType, UInt64 fragmentId, UInt8 groupMarker, UInt8 splitId) {
+		splittedId = splitId;
+		type = mediaType;
+		marker = groupMarker;
+		this->time = time;
+		buffer.resize(totalSize, false);
+		BinaryWriter writer(buffer.data(), totalSize);
 
 		// AMF Group marker
 		writer.write8(marker);
@@ -54,9 +61,9 @@ public:
 		writer.write(data, size);
 	}
 
-	UInt32 payloadSize() { return pBuffer.size() - (payload - pBuffer.data()); }
+	UInt32 payloadSize() { return buffer.size() - (payload - buffer.data()); }
 
-	PoolBuffer			pBuffer;
+	Buffer				buffer;
 	UInt32				time;
 	AMF::ContentType	type;
 	const UInt8*		payload; // Payload position
@@ -64,12 +71,29 @@ public:
 	UInt8				splittedId;
 };
 
-Buffer	GroupMedia::_fragmentsMapBuffer;
 UInt32	GroupMedia::GroupMediaCounter = 0;
 
-GroupMedia::GroupMedia(const PoolBuffers& poolBuffers, const string& name, const string& key, std::shared_ptr<RTMFPGroupConfig> parameters) : _fragmentCounter(0), _firstPushMode(true), _currentPushMask(0), 
-	_currentPullFragment(0), _itPullPeer(_mapPeers.end()), _itPushPeer(_mapPeers.end()), _itFragmentsPeer(_mapPeers.end()), _lastFragmentMapId(0), _firstPullReceived(false), _poolBuffers(poolBuffers), 
-	_stream(name), _streamKey(key), groupParameters(parameters), id(++GroupMediaCounter) {
+GroupMedia::GroupMedia(const PoolBuffers& poolBuffers, TimerWheel& timers, const string& name, const string& key, std::shared_ptr<RTMFPGroupConfig> parameters) : _fragmentCounter(0), _firstPushMode(true), _currentPushMask(0), 
+	_currentPullFragment(0), _itPullPeer(_mapPeers.end()), _itPushPeer(_mapPeers.end()), _itFragmentsPeer(_mapPeers.end()), _lastFragmentMapId(0), _firstPullReceived(false), _fragmentsMapChanged(false), _poolBuffers(poolBuffers), 
+	_timers(timers), _lastPushUpdate(timers.now()), _stream(name), _streamKey(key), groupParameters(parameters), id(++GroupMediaCounter) {
+
+	_fragmentsMapTimer.onTimer = [this](Int64 now) { manageFragmentsMap(now); };
+	_timers.set(_fragmentsMapTimer, _timers.now() + groupParameters->availabilityUpdatePeriod + 1);
+
+	// Push and Pull requests are only sent by the players
+	if (!groupParameters->isPublisher) {
+		_pushTimer.onTimer = [this](Int64 now) {
+			if (now - _lastPushUpdate > NETGROUP_PUSH_DELAY)
+				sendPushRequests();
+			_timers.set(_pushTimer, _lastPushUpdate + NETGROUP_PUSH_DELAY + 1);
+		};
+		_timers.set(_pushTimer, _timers.now() + NETGROUP_PUSH_DELAY + 1);
+		_pullTimer.onTimer = [this](Int64 now) {
+			sendPullRequests();
+			_timers.set(_pullTimer, now + NETGROUP_PULL_DELAY);
+		};
+		_timers.set(_pullTimer, _timers.now() + NETGROUP_PULL_DELAY);
+	}
 
 	onPeerClose = [this](const string& peerId, UInt8 mask) {
 		// unset push masks
@@ -86,14 +110,14 @@ GroupMedia::GroupMedia(const PoolBuffers& poolBuffers, const string& name, const
 	};
 	onPlayPull = [this](PeerMedia* pPeer, UInt64 index) {
 
-		auto itFragment = _fragments.find(index);
-		if (itFragment == _fragments.end()) {
+		MediaPacket* pFragment = _fragments.get(index);
+		if (!pFragment) {
 			DEBUG("GroupMedia ", id, " - Peer is asking for an unknown Fragment (", index, "), possibly deleted")
 			return;
 		}
 
 		// Send fragment to peer (pull mode)
-		pPeer->sendMedia(itFragment->second.pBuffer.data(), itFragment->second.pBuffer.size(), itFragment->first, true);
+		pPeer->sendMedia(pFragment->buffer.data(), pFragment->buffer.size(), index, true);
 	};
 	onFragmentsMap = [this](UInt64 counter) {
 		if (groupParameters->isPublisher)
@@ -101,7 +125,7 @@ GroupMedia::GroupMedia(const PoolBuffers& poolBuffers, const string& name, const
 
 		// Record the idenfier for future pull requests
 		if (_lastFragmentMapId < counter) {
-			_mapPullTime2Fragment.emplace(Time::Now(), counter);
+			_mapPullTime2Fragment.emplace(_timers.now(), counter);
 			_lastFragmentMapId = counter;
 		}
 
@@ -118,14 +142,13 @@ GroupMedia::GroupMedia(const PoolBuffers& poolBuffers, const string& name, const
 		UInt8 splitCounter = size / NETGROUP_MAX_PACKET_SIZE - ((size % NETGROUP_MAX_PACKET_SIZE) == 0);
 		UInt8 marker = GroupStream::GROUP_MEDIA_DATA ;
 		TRACE("GroupMedia ", id, " - Creating fragments ", _fragmentCounter + 1, " to ", _fragmentCounter + splitCounter, " - time : ", time)
-		auto itFragment = _fragments.end();
 		do {
 			if (size > NETGROUP_MAX_PACKET_SIZE)
 				marker = splitCounter == 0 ? GroupStream::GROUP_MEDIA_END : (pos == data ? GroupStream::GROUP_MEDIA_START : GroupStream::GROUP_MEDIA_NEXT);
 
 			// Add the fragment to the map
 			UInt32 fragmentSize = ((splitCounter > 0) ? NETGROUP_MAX_PACKET_SIZE : (end - pos));
-			addFragment(itFragment, NULL, marker, ++_fragmentCounter, splitCounter, type, time, pos, fragmentSize);
+			addFragment(NULL, marker, ++_fragmentCounter, splitCounter, type, time, pos, fragmentSize);
 
 			pos += splitCounter > 0 ? NETGROUP_MAX_PACKET_SIZE : (end - pos);
 		} while (splitCounter-- > 0);
@@ -174,17 +197,17 @@ GroupMedia::GroupMedia(const PoolBuffers& poolBuffers, const string& name, const
 				DEBUG("GroupMedia ", id, " - Unexpected fragment received from ", peerId, " : ", fragmentId, " ; mask : ", Format<UInt8>("%.2x", mask))
 		}
 
-		auto itFragment = _fragments.lower_bound(fragmentId);
-		if (itFragment != _fragments.end() && itFragment->first == fragmentId) {
+		if (_fragments.has(fragmentId)) {
 			TRACE("GroupMedia ", id, " - Fragment ", fragmentId, " already received, ignored")
 			return;
 		}
 
-		// Add the fragment to the map
-		addFragment(itFragment, pPeer, marker, fragmentId, splitedNumber, mediaType, time, packet.current(), packet.available());
+		// Add the fragment to the window
+		if (!addFragment(pPeer, marker, fragmentId, splitedNumber, mediaType, time, packet.current(), packet.available()))
+			return;
 
 		// Push the fragment to the output file (if ordered)
-		pushFragment(itFragment);
+		pushFragment(fragmentId);
 	};
 }
 
@@ -196,34 +219,39 @@ GroupMedia::~GroupMedia() {
 		removePeer(itPeer++);
 
 	_fragments.clear();
-	_mapTime2Fragment.clear();
 }
 
-void GroupMedia::addFragment(MAP_FRAGMENTS_ITERATOR& itFragment, PeerMedia* pPeer, UInt8 marker, UInt64 id, UInt8 splitedNumber, UInt8 mediaType, UInt32 time, const UInt8* data, UInt32 size) {
+MediaPacket* GroupMedia::addFragment(PeerMedia* pPeer, UInt8 marker, UInt64 id, UInt8 splitedNumber, UInt8 mediaType, UInt32 time, const UInt8* data, UInt32 size) {
+	MediaPacket* pFragment = _fragments.add(id);
+	if (!pFragment) {
+		WARN("GroupMedia ", this->id, " - Fragment ", id, " is too far from the current window (", _fragments.first(), " to ", _fragments.last(), "), ignored")
+		return NULL;
+	}
 	UInt32 bufferSize = size + 1 + 5 * (marker == GroupStream::GROUP_MEDIA_START || marker == GroupStream::GROUP_MEDIA_DATA) + (splitedNumber > 0) + Util::Get7BitValueSize(id);
-	itFragment = _fragments.emplace_hint(itFragment, piecewise_construct, forward_as_tuple(id), forward_as_tuple(_poolBuffers, data, size, bufferSize, time, (AMF::ContentType)mediaType,
-		id, marker, splitedNumber));
+	pFragment->set(data, size, bufferSize, time, (AMF::ContentType)mediaType, id, marker, splitedNumber);
+	_fragmentsMapChanged = true;
 
 	// Send fragment to peers (push mode)
 	UInt8 nbPush = groupParameters->pushLimit + 1;
 	for (auto it : _mapPeers) {
-		if (it.second.get() != pPeer && it.second->sendMedia(itFragment->second.pBuffer.data(), itFragment->second.pBuffer.size(), id) && (--nbPush == 0)) {
+		if (it.second.get() != pPeer && it.second->sendMedia(pFragment->buffer.data(), pFragment->buffer.size(), id) && (--nbPush == 0)) {
 			TRACE("GroupMedia ", id, " - Push limit (", groupParameters->pushLimit + 1, ") reached for fragment ", id, " (mask=", Format<UInt8>("%.2x", 1 << (id % 8)), ")")
 			break;
 		}
 	}
-
-	if ((marker == GroupStream::GROUP_MEDIA_DATA || marker == GroupStream::GROUP_MEDIA_START) && (_mapTime2Fragment.empty() || time > _mapTime2Fragment.rbegin()->first))
-		_mapTime2Fragment[time] = id;
+	return pFragment;
 }
 
-void GroupMedia::manage() {
-	if (_mapPeers.empty())
+void GroupMedia::manageFragmentsMap(Int64 now) {
+	_timers.set(_fragmentsMapTimer, now + max<UInt32>(groupParameters->availabilityUpdatePeriod, 1));
+	if (_mapPeers.empty()) {
+		eraseOldFragments(); // keep the window duration even without peers
 		return;
+	}
 
 	// Send the Fragments Map message
 	UInt64 lastFragment(0);
-	if (_lastFragmentsMap.isElapsed(groupParameters->availabilityUpdatePeriod) && (lastFragment = updateFragmentMap())) {
+	if ((lastFragment = updateFragmentMap())) {
 
 		// Send to all neighbors
 		if (groupParameters->availabilitySendToAll) {
@@ -236,18 +264,6 @@ void GroupMedia::manage() {
 					|| getNextPeer(_itFragmentsPeer, false, 0, 0))
 				_itFragmentsPeer->second->sendFragmentsMap(lastFragment, _fragmentsMapBuffer.data(), _fragmentsMapBuffer.size());
 		}
-		_lastFragmentsMap.update();
-	}
-
-	// Send the Push requests
-	if (!groupParameters->isPublisher && _lastPushUpdate.isElapsed(NETGROUP_PUSH_DELAY))
-		sendPushRequests();
-
-	// Send the Pull requests
-	if (!groupParameters->isPublisher && _lastPullUpdate.isElapsed(NETGROUP_PULL_DELAY)) {
-
-		sendPullRequests();
-		_lastPullUpdate.update();
 	}
 }
 
@@ -311,49 +327,52 @@ void GroupMedia::eraseOldFragments() {
 	if (_fragments.empty())
 		return;
 
-	UInt32 end = _fragments.rbegin()->second.time;
+	UInt32 end = _fragments.get(_fragments.last())->time;
 	UInt32 time2Keep = end - (groupParameters->windowDuration + groupParameters->relayMargin);
-	auto itTime = _mapTime2Fragment.lower_bound(time2Keep);
 
-	// To not delete more than the window duration
-	if (itTime != _mapTime2Fragment.end() && time2Keep > itTime->first)
-		--itTime;
+	// Search the first reference (START or DATA fragment) in the window duration, older fragments are scanned only once
+	UInt64 firstReference(0), reference(0);
+	MediaPacket* pReference(NULL);
+	for (UInt64 index = _fragments.first(); index; index = _fragments.next(index)) {
+		MediaPacket* pFragment = _fragments.get(index);
+		if (pFragment->marker != GroupStream::GROUP_MEDIA_DATA && pFragment->marker != GroupStream::GROUP_MEDIA_START)
+			continue;
+		if (!firstReference)
+			firstReference = index;
+		if (pFragment->time >= time2Keep) {
+			reference = index;
+			pReference = pFragment;
+			break;
+		}
+	}
 		
 	// Ignore if no fragment found or if it is the first reference
-	if (itTime == _mapTime2Fragment.end() || itTime == _mapTime2Fragment.begin())
+	if (!reference || reference == firstReference)
 		return;
 
-	auto itFragment = _fragments.find(itTime->second);
-	if (itFragment == _fragments.end()) {
-		ERROR("GroupMedia ", id, " - Unable to find the fragment ", itTime->second, " for cleaning buffer") // implementation error
-		return;
+	// Get the first fragment before the reference
+	UInt64 lastFragment = _fragments.previous(reference);
+	if (_fragmentCounter < lastFragment) {
+		WARN("GroupMedia ", id, " - Deleting unread fragments to keep the window duration... (", lastFragment - _fragmentCounter, " fragments ignored)")
+		_fragmentCounter = lastFragment;
 	}
 
-	// Get the first fragment before the itTime reference
-	--itFragment;
-	if (_fragmentCounter < itFragment->first) {
-		WARN("GroupMedia ", id, " - Deleting unread fragments to keep the window duration... (", itFragment->first - _fragmentCounter, " fragments ignored)")
-		_fragmentCounter = itFragment->first;
-	}
-
-	DEBUG("GroupMedia ", id, " - Deletion of fragments ", _fragments.begin()->first, " (~", _mapTime2Fragment.begin()->first, ") to ",
-		itFragment->first, " (~", itTime->first, ") - current time : ", end)
-	_fragments.erase(_fragments.begin(), itFragment);
-	_mapTime2Fragment.erase(_mapTime2Fragment.begin(), itTime);
+	DEBUG("GroupMedia ", id, " - Deletion of fragments ", _fragments.first(), " (~", _fragments.get(firstReference)->time, ") to ",
+		lastFragment, " (~", pReference->time, ") - current time : ", end)
+	_fragments.removeBefore(lastFragment);
+	_fragmentsMapChanged = true;
 
 	// Delete the old waiting fragments
-	auto itWait = _mapWaitingFragments.lower_bound(itFragment->first);
-	if (!_mapWaitingFragments.empty() && _mapWaitingFragments.begin()->first < itFragment->first) {
+	auto itWait = _mapWaitingFragments.lower_bound(lastFragment);
+	if (!_mapWaitingFragments.empty() && _mapWaitingFragments.begin()->first < lastFragment) {
 		WARN("GroupMedia ", id, " - Deletion of waiting fragments ", _mapWaitingFragments.begin()->first, " to ", (itWait == _mapWaitingFragments.end())? _mapWaitingFragments.rbegin()->first : itWait->first)
 		_mapWaitingFragments.erase(_mapWaitingFragments.begin(), itWait);
 	}
-	if (_currentPullFragment < itFragment->first)
-		_currentPullFragment = itFragment->first; // move the current pull fragment to the 1st fragment
+	if (_currentPullFragment < lastFragment)
+		_currentPullFragment = lastFragment; // move the current pull fragment to the 1st fragment
 
 	// Try to push again the last fragments
-	auto itLast = _fragments.find(_fragmentCounter + 1);
-	if (itLast != _fragments.end())
-		pushFragment(itLast);
+	pushFragment(_fragmentCounter + 1);
 }
 
 UInt64 GroupMedia::updateFragmentMap() {
@@ -363,116 +382,105 @@ UInt64 GroupMedia::updateFragmentMap() {
 	// First we erase old fragments
 	eraseOldFragments();
 
+	UInt64 lastFragment = _fragments.last();
+	if (!_fragmentsMapChanged)
+		return lastFragment; // nothing new since the last generation
+	_fragmentsMapChanged = false;
+
 	// Generate the report message
-	UInt64 firstFragment = _fragments.begin()->first;
-	UInt64 lastFragment = _fragments.rbegin()->first;
-	UInt64 nbFragments = lastFragment - firstFragment; // number of fragments - the first one
-	_fragmentsMapBuffer.resize((UInt32)((nbFragments / 8) + ((nbFragments % 8) > 0)) + Util::Get7BitValueSize(lastFragment) + 1, false);
+	UInt64 nbFragments = lastFragment - _fragments.first(); // number of fragments - the first one
+	UInt32 mapSize = (UInt32)((nbFragments / 8) + ((nbFragments % 8) > 0));
+	_fragmentsMapBuffer.resize(mapSize + Util::Get7BitValueSize(lastFragment) + 1, false);
 	BinaryWriter writer(BIN _fragmentsMapBuffer.data(), _fragmentsMapBuffer.size());
 	writer.write8(GroupStream::GROUP_FRAGMENTS_MAP).write7BitLongValue(lastFragment);
 
-	// If there is only one fragment we just write its counter
-	if (!nbFragments)
-		return lastFragment;
-
-	if (groupParameters->isPublisher) { // Publisher : We have all fragments, faster treatment
-		
-		while (nbFragments > 8) {
-			writer.write8(0xFF);
-			nbFragments -= 8;
-		}
-		UInt8 lastByte = 1;
-		while (--nbFragments > 0)
-			lastByte = (lastByte << 1) + 1;
-		writer.write8(lastByte);
-	}
-	else {
-		// Loop on each bit
-		for (UInt64 index = lastFragment - 1; index >= firstFragment && index >= 8; index -= 8) {
-
-			UInt8 currentByte = 0;
-			for (UInt8 fragment = 0; fragment < 8 && (index-fragment) >= firstFragment; fragment++) {
-				if (_fragments.find(index - fragment) != _fragments.end())
-					currentByte += (1 << fragment);
-			}
-			writer.write8(currentByte);
+	// Each byte gives the 8 fragments preceding the previous byte (bit 0 is the most recent), 
+	// so the bitmap is read by words of 64 fragments and reversed
+	UInt8* current = _fragmentsMapBuffer.data() + writer.size();
+	for (UInt64 index = lastFragment - 1; mapSize; index -= 64) {
+		UInt64 bits = Bits::Reverse((index >= 64) ? _fragments.bits(index - 63) : (_fragments.bits(1) << (64 - index)));
+		for (UInt8 i = 0; i < 8 && mapSize; ++i, --mapSize) {
+			*current++ = (UInt8)bits;
+			bits >>= 8;
 		}
 	}
 
 	return lastFragment;
 }
 
-bool GroupMedia::pushFragment(map<UInt64, MediaPacket>::iterator& itFragment) {
-	if (itFragment == _fragments.end() || !_firstPullReceived)
+bool GroupMedia::pushFragment(UInt64 fragmentId) {
+	MediaPacket* pFragment = _fragments.get(fragmentId);
+	if (!pFragment || !_firstPullReceived)
 		return false;
 
 	// Stand alone fragment (special case : sometime Flash send media END without splitted fragments)
-	if (itFragment->second.marker == GroupStream::GROUP_MEDIA_DATA || (itFragment->second.marker == GroupStream::GROUP_MEDIA_END && itFragment->first == _fragmentCounter + 1)) {
+	if (pFragment->marker == GroupStream::GROUP_MEDIA_DATA || (pFragment->marker == GroupStream::GROUP_MEDIA_END && fragmentId == _fragmentCounter + 1)) {
 		// Is it the next fragment?
-		if (_fragmentCounter == 0 || itFragment->first == _fragmentCounter + 1) {
-			_fragmentCounter = itFragment->first;
+		if (_fragmentCounter == 0 || fragmentId == _fragmentCounter + 1) {
+			_fragmentCounter = fragmentId;
 
-			TRACE("GroupMedia ", id, " - Pushing Media Fragment ", itFragment->first)
-			if (itFragment->second.type == AMF::AUDIO || itFragment->second.type == AMF::VIDEO)
-				OnGroupPacket::raise(itFragment->second.time, itFragment->second.payload, itFragment->second.payloadSize(), 0, itFragment->second.type == AMF::AUDIO);
+			TRACE("GroupMedia ", id, " - Pushing Media Fragment ", fragmentId)
+			if (pFragment->type == AMF::AUDIO || pFragment->type == AMF::VIDEO)
+				OnGroupPacket::raise(pFragment->time, pFragment->payload, pFragment->payloadSize(), 0, pFragment->type == AMF::AUDIO);
 
-			return pushFragment(++itFragment); // Go to next fragment
+			return pushFragment(fragmentId + 1); // Go to next fragment
 		}
 	}
 	// Splitted packet
 	else  {
 		if (_fragmentCounter == 0) {
 			// Delete first splitted fragments
-			if (itFragment->second.marker != GroupStream::GROUP_MEDIA_START) {
-				TRACE("GroupMedia ", id, " - Ignoring splitted fragment ", itFragment->first, ", we are waiting for a starting fragment")
-				_fragments.erase(itFragment);
+			if (pFragment->marker != GroupStream::GROUP_MEDIA_START) {
+				TRACE("GroupMedia ", id, " - Ignoring splitted fragment ", fragmentId, ", we are waiting for a starting fragment")
+				_fragments.remove(fragmentId);
+				_fragmentsMapChanged = true;
 				return false;
 			}
 			else {
 				TRACE("GroupMedia ", id, " - First fragment is a Start Media Fragment")
-				_fragmentCounter = itFragment->first-1; // -1 to be catched by the next fragment condition 
+				_fragmentCounter = fragmentId-1; // -1 to be catched by the next fragment condition 
 			}
 		}
 
 		// Search the start fragment
-		auto itStart = itFragment;
-		while (itStart->second.marker != GroupStream::GROUP_MEDIA_START) {
-			itStart = _fragments.find(itStart->first - 1);
-			if (itStart == _fragments.end())
+		UInt64 idStart = fragmentId;
+		MediaPacket* pStart = pFragment;
+		while (pStart->marker != GroupStream::GROUP_MEDIA_START) {
+			if (!(pStart = _fragments.get(--idStart)))
 				return false; // ignore these fragments if there is a hole
 		}
 		
 		// Check if all splitted fragments are present
-		UInt8 nbFragments = itStart->second.splittedId+1;
-		UInt32 payloadSize = itStart->second.payloadSize();
-		auto itEnd = itStart;
+		UInt8 nbFragments = pStart->splittedId+1;
+		UInt32 payloadSize = pStart->payloadSize();
+		UInt64 idEnd = idStart;
 		for (int i = 1; i < nbFragments; ++i) {
-			itEnd = _fragments.find(itStart->first + i);
-			if (itEnd == _fragments.end())
+			MediaPacket* pEnd = _fragments.get(++idEnd);
+			if (!pEnd)
 				return false; // ignore these fragments if there is a hole
 
-			payloadSize += itEnd->second.payloadSize();
+			payloadSize += pEnd->payloadSize();
 		}
 
 		// Is it the next fragment?
-		if (itStart->first == _fragmentCounter + 1) {
-			_fragmentCounter = itEnd->first;
+		if (idStart == _fragmentCounter + 1) {
+			_fragmentCounter = idEnd;
 
 			// Buffer the fragments and write to file if audio/video
-			if (itStart->second.type == AMF::AUDIO || itStart->second.type == AMF::VIDEO) {
-				Buffer	payload(payloadSize);
-				BinaryWriter writer(payload.data(), payloadSize);
-				auto	itCurrent = itStart;
+			if (pStart->type == AMF::AUDIO || pStart->type == AMF::VIDEO) {
+				_payloadBuffer.resize(payloadSize, false); // capacity is kept between frames
+				BinaryWriter writer(_payloadBuffer.data(), payloadSize);
 
-				do {
-					writer.write(itCurrent->second.payload, itCurrent->second.payloadSize());
-				} while (itCurrent++ != itEnd);
+				for (UInt64 idCurrent = idStart; idCurrent <= idEnd; ++idCurrent) {
+					MediaPacket* pCurrent = _fragments.get(idCurrent);
+					writer.write(pCurrent->payload, pCurrent->payloadSize());
+				}
 
-				TRACE("GroupMedia ", id, " - Pushing splitted packet ", itStart->first, " - ", nbFragments, " fragments for a total size of ", payloadSize)
-				OnGroupPacket::raise(itStart->second.time, payload.data(), payloadSize, 0, itStart->second.type == AMF::AUDIO);
+				TRACE("GroupMedia ", id, " - Pushing splitted packet ", idStart, " - ", nbFragments, " fragments for a total size of ", payloadSize)
+				OnGroupPacket::raise(pStart->time, _payloadBuffer.data(), payloadSize, 0, pStart->type == AMF::AUDIO);
 			}
 
-			return pushFragment(++itEnd);
+			return pushFragment(idEnd + 1);
 		}
 	}
 
@@ -494,14 +502,14 @@ void GroupMedia::sendPushRequests() {
 			TRACE("GroupMedia ", id, " - Push In - No new peer available for mask ", Format<UInt8>("%.2x", _currentPushMask))
 	}
 
-	_lastPushUpdate.update();
+	_lastPushUpdate = _timers.now();
 }
 
 void GroupMedia::sendPullRequests() {
 	if (_mapPullTime2Fragment.empty()) // not started yet
 		return;
 
-	Int64 timeNow(Time::Now());
+	Int64 timeNow(_timers.now());
 	Int64 timeMax = timeNow - groupParameters->fetchPeriod;
 	auto maxFragment = _mapPullTime2Fragment.lower_bound(timeMax);
 	if (maxFragment == _mapPullTime2Fragment.begin() || maxFragment == _mapPullTime2Fragment.end()) {
@@ -519,9 +527,9 @@ void GroupMedia::sendPullRequests() {
 		_itPullPeer = _mapPeers.begin();
 		if (RTMFP::getRandomIt<MAP_PEERS_INFO_TYPE, MAP_PEERS_INFO_ITERATOR_TYPE>(_mapPeers, itRandom1, [this](const MAP_PEERS_INFO_ITERATOR_TYPE& it) { return it->second->hasFragment(_currentPullFragment); })) {
 			TRACE("GroupMedia ", id, " - sendPullRequests - first fragment found : ", _currentPullFragment)
-			if (_fragments.find(_currentPullFragment) == _fragments.end()) { // ignoring if already received
+			if (!_fragments.has(_currentPullFragment)) { // ignoring if already received
 				itRandom1->second->sendPull(_currentPullFragment);
-				_mapWaitingFragments.emplace(piecewise_construct, forward_as_tuple(_currentPullFragment), forward_as_tuple(itRandom1->first.c_str()));
+				_mapWaitingFragments.emplace(piecewise_construct, forward_as_tuple(_currentPullFragment), forward_as_tuple(itRandom1->first.c_str(), _timers.now()));
 			}
 			else
 				_firstPullReceived = true;
@@ -529,9 +537,9 @@ void GroupMedia::sendPullRequests() {
 			TRACE("GroupMedia ", id, " - sendPullRequests - Unable to find the first fragment (", _currentPullFragment, ")")
 		if (RTMFP::getRandomIt<MAP_PEERS_INFO_TYPE, MAP_PEERS_INFO_ITERATOR_TYPE>(_mapPeers, _itPullPeer, [this](const MAP_PEERS_INFO_ITERATOR_TYPE& it) { return it->second->hasFragment(_currentPullFragment + 1); })) {
 			TRACE("GroupMedia ", id, " - sendPullRequests - second fragment found : ", _currentPullFragment + 1)
-			if (_fragments.find(++_currentPullFragment) == _fragments.end()) { // ignoring if already received
+			if (!_fragments.has(++_currentPullFragment)) { // ignoring if already received
 				_itPullPeer->second->sendPull(_currentPullFragment);
-				_mapWaitingFragments.emplace(piecewise_construct, forward_as_tuple(_currentPullFragment), forward_as_tuple(_itPullPeer->first.c_str()));
+				_mapWaitingFragments.emplace(piecewise_construct, forward_as_tuple(_currentPullFragment), forward_as_tuple(_itPullPeer->first.c_str(), _timers.now()));
 			}
 			else
 				_firstPullReceived = true;
@@ -550,7 +558,7 @@ void GroupMedia::sendPullRequests() {
 		for (auto itPull = _mapWaitingFragments.begin(); itPull != _mapWaitingFragments.end() && itPull->first <= lastOldFragment; itPull++) {
 
 			// Fetch period elapsed? => blacklist the peer and send back the request to another peer
-			if (itPull->second.time.isElapsed(groupParameters->fetchPeriod)) {
+			if (timeNow - itPull->second.time > groupParameters->fetchPeriod) {
 
 				DEBUG("GroupMedia ", id, " - sendPullRequests - ", groupParameters->fetchPeriod, "ms without receiving fragment ", itPull->first, ", blacklisting peer ", itPull->second.peerId)
 				auto itPeer = _mapPeers.find(itPull->second.peerId);
@@ -559,18 +567,37 @@ void GroupMedia::sendPullRequests() {
 				
 				if (sendPullToNextPeer(itPull->first)) {
 					itPull->second.peerId = _itPullPeer->first.c_str();
-					itPull->second.time.update();
+					itPull->second.time = timeNow;
 				}
 			}
 		}
 	}
 
-	// Find the holes and send pull requests
-	for (; _currentPullFragment < lastFragment; _currentPullFragment++) {
+	// Find the holes and send pull requests, the holes and the availability of the peers are read by words of 64 fragments
+	_pullPeers.clear();
+	size_t current = _mapPeers.size();
+	for (auto itPeer = _mapPeers.begin(); itPeer != _mapPeers.end(); ++itPeer) {
+		if (itPeer == _itPullPeer)
+			current = _pullPeers.size();
+		_pullPeers.emplace_back(itPeer);
+	}
+	bool available(true);
+	for (UInt64 index = _currentPullFragment + 1; available && index <= lastFragment; index += 64) {
+
+		UInt64 holes = ~_fragments.bits(index);
+		if (lastFragment - index < 63)
+			holes &= (1ULL << (lastFragment - index + 1)) - 1;
+		if (holes) {
+			for (PullPeer& peer : _pullPeers)
+				peer.fragments = peer.itPeer->second->availableFragments(index);
+		}
+		while (holes && (available = sendPullToNextPeer(index + Bits::TrailingZeros(holes), Bits::TrailingZeros(holes), current)))
+			holes &= holes - 1;
 
-		if (_fragments.find(_currentPullFragment + 1) == _fragments.end() && !sendPullToNextPeer(_currentPullFragment + 1))
-			break; // we wait for the fragment to be available
+		// If a fragment is not available we wait for it
+		_currentPullFragment = available ? min(index + 63, lastFragment) : index + Bits::TrailingZeros(holes) - 1;
 	}
+	_itPullPeer = (current < _pullPeers.size()) ? _pullPeers[current].itPeer : _mapPeers.end();
 
 	TRACE("GroupMedia ", id, " - sendPullRequests - Pull requests done : ", _mapWaitingFragments.size(), " waiting fragments (current : ", _currentPullFragment, "; last Fragment : ", lastFragment, ")")
 }
@@ -583,7 +610,34 @@ bool GroupMedia::sendPullToNextPeer(UInt64 idFragment) {
 	}
 	
 	_itPullPeer->second->sendPull(idFragment);
-	_mapWaitingFragments.emplace(piecewise_construct, forward_as_tuple(idFragment), forward_as_tuple(_itPullPeer->first.c_str()));
+	_mapWaitingFragments.emplace(piecewise_construct, forward_as_tuple(idFragment), forward_as_tuple(_itPullPeer->first.c_str(), _timers.now()));
+	return true;
+}
+
+bool GroupMedia::sendPullToNextPeer(UInt64 idFragment, UInt8 bit, size_t& current) {
+	UInt64 mask = 1ULL << bit;
+	bool found(false);
+
+	// Same order as getNextPeer() (ascending)
+	if (_pullPeers.size() == 1) {
+		current = 0;
+		found = (_pullPeers[0].fragments & mask) != 0;
+	}
+	else if (!_pullPeers.empty()) {
+		size_t begin = current;
+		do {
+			current = (current >= _pullPeers.size()) ? 0 : current + 1;
+			found = (current < _pullPeers.size()) && (_pullPeers[current].fragments & mask);
+		} while (!found && current != begin);
+	}
+	if (!found) {
+		DEBUG("GroupMedia ", id, " - sendPullRequests - No peer found for fragment ", idFragment)
+		return false;
+	}
+
+	MAP_PEERS_INFO_ITERATOR_TYPE& itPeer = _pullPeers[current].itPeer;
+	itPeer->second->sendPull(idFragment);
+	_mapWaitingFragments.emplace(piecewise_construct, forward_as_tuple(idFragment), forward_as_tuple(itPeer->first.c_str(), _timers.now()));
 	return true;
 }
 
@@ -625,7 +679,7 @@ void GroupMedia::callFunction(const char* function, int nbArgs, const char** arg
 			writer.writeString(args[i], strlen(args[i]));
 	}
 
-	UInt32 currentTime = (_fragments.empty())? 0 : _fragments.rbegin()->second.time;
+	UInt32 currentTime = (_fragments.empty())? 0 : _fragments.get(_fragments.last())->time;
 
 	// Create and send the fragment
 	TRACE("Creating fragment for function ", function, "...")
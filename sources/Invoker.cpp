@@ -27,7 +27,7 @@ using namespace std;
 
 /** ConnectionsManager **/
 
-ConnectionsManager::ConnectionsManager(Invoker& invoker):_invoker(invoker),Task(invoker),Startable("ServerManager") {
+ConnectionsManager::ConnectionsManager(ConnectionsShard& shard):_shard(shard),Task(shard),Startable("ServerManager") {
 }
 
 void ConnectionsManager::run(Exception& ex) {
@@ -36,11 +36,104 @@ void ConnectionsManager::run(Exception& ex) {
 	} while (sleep(DELAY_CONNECTIONS_MANAGER) != STOP);
 }
 
-void ConnectionsManager::handle(Exception& ex) { _invoker.manage(); }
+void ConnectionsManager::handle(Exception& ex) { _shard.manage(); }
+
+/** ConnectionsShard **/
+
+ConnectionsShard::ConnectionsShard(Invoker& invoker) : Startable("ConnectionsShard"), _invoker(invoker), _manager(*this), _count(0) {
+}
+
+ConnectionsShard::~ConnectionsShard() {
+	Startable::stop();
+
+	clear();
+}
+
+bool ConnectionsShard::start() {
+	Exception ex;
+	bool result;
+	EXCEPTION_TO_LOG(result = Startable::start(ex, Startable::PRIORITY_HIGH), "ConnectionsShard");
+	if (result)
+		TaskHandler::start();
+	return result;
+}
+
+void ConnectionsShard::addConnection(unsigned int index, shared_ptr<RTMFPSession>& pConn) {
+	lock_guard<recursive_mutex>	lock(_mutexConnections);
+	_mapConnections.emplace(index, pConn);
+	++_count;
+}
+
+bool ConnectionsShard::getConnection(unsigned int index, shared_ptr<RTMFPSession>& pConn) {
+	lock_guard<recursive_mutex>	lock(_mutexConnections);
+	auto it = _mapConnections.find(index);
+	if (it == _mapConnections.end())
+		return false;
+
+	pConn = it->second;
+	return true;
+}
+
+bool ConnectionsShard::removeConnection(unsigned int index) {
+	lock_guard<recursive_mutex>	lock(_mutexConnections);
+	auto it = _mapConnections.find(index);
+	if (it == _mapConnections.end())
+		return false;
+
+	_mapConnections.erase(it);
+	--_count;
+	return true;
+}
+
+void ConnectionsShard::clear() {
+	lock_guard<recursive_mutex>	lock(_mutexConnections);
+	_mapConnections.clear();
+	_count = 0;
+}
+
+void ConnectionsShard::manage() {
+	bool removed(false);
+	{
+		lock_guard<recursive_mutex>	lock(_mutexConnections);
+		auto it = _mapConnections.begin();
+		while (it != _mapConnections.end()) {
+			it->second->manage();
+
+			if (it->second->closed()) {
+				INFO("Deleting connection ", it->first, "...")
+				_mapConnections.erase(it++);
+				--_count;
+				removed = true;
+				continue;
+			}
+			it++;
+		}
+	}
+
+	// Lock of the shard released to not wait for the other shards
+	if (removed)
+		_invoker.terminateIfEmpty();
+}
+
+void ConnectionsShard::run(Exception& exc) {
+	Exception exWarn, ex;
+
+	if (!_manager.start(exWarn, Startable::PRIORITY_LOW))
+		ex = exWarn;
+	else if (exWarn)
+		WARN(exWarn.error());
+	while (!ex && sleep() != STOP)
+		giveHandle(ex);
+
+	// terminate the tasks (forced to do immediatly, because no more "giveHandle" is called)
+	TaskHandler::stop();
+
+	_manager.stop();
+}
 
 /** Invoker **/
 
-Invoker::Invoker(UInt16 threads) : Startable("Invoker"), poolThreads(threads), sockets(*this, poolBuffers, poolThreads), _manager(*this), _lastIndex(0), _init(false) {
+Invoker::Invoker(UInt16 threads) : Startable("Invoker"), poolThreads(threads), sockets(*this, poolBuffers, poolThreads), _lastIndex(0), _init(false), _nbShards(0), _maxShards(1) {
 	_globalLogger.reset(new RTMFPLogger());
 	Logs::SetLogger(*_globalLogger);
 }
@@ -69,82 +162,100 @@ bool Invoker::start() {
 	return result;
 }
 
+void Invoker::setManagerThreads(UInt16 threads) {
+	if (!threads)
+		threads = 1;
+	else if (threads > MAX_CONNECTIONS_SHARDS)
+		threads = MAX_CONNECTIONS_SHARDS;
+	_maxShards = threads;
+}
+
 unsigned int Invoker::addConnection(std::shared_ptr<RTMFPSession>& pConn) {
-	lock_guard<recursive_mutex>	lock(_mutexConnections);
+	lock_guard<mutex>	lock(_mutexShards);
+
+	// Choose the shard with the fewest connections, start a new one if they are all used
+	UInt16 nbShards = _nbShards, index = 0;
+	for (UInt16 i = 1; i < nbShards; ++i) {
+		if (_shards[i]->count() < _shards[index]->count())
+			index = i;
+	}
+	if (!nbShards || (_shards[index]->count() && nbShards < _maxShards)) {
+		index = nbShards;
+		_shards[index].reset(new ConnectionsShard(*this));
+		if (!_shards[index]->start()) {
+			_shards[index].reset();
+			if (!nbShards)
+				return 0;
+			index = 0;
+		}
+		else
+			_nbShards = nbShards + 1;
+	}
+
 	_init = true;
-	_mapConnections.emplace(++_lastIndex, pConn);
-	return _lastIndex; // Index of a connection is the position in the vector + 1 (0 is reserved for errors)
+	unsigned int connection = (++_lastIndex) * MAX_CONNECTIONS_SHARDS + index; // 0 is reserved for errors
+	_shards[index]->addConnection(connection, pConn);
+	return connection;
+}
+
+ConnectionsShard* Invoker::shard(unsigned int index) {
+	UInt16 shard = index % MAX_CONNECTIONS_SHARDS;
+	return (index && shard < _nbShards) ? _shards[shard].get() : NULL;
 }
 
 bool	Invoker::getConnection(unsigned int index, std::shared_ptr<RTMFPSession>& pConn) {
-	lock_guard<recursive_mutex>	lock(_mutexConnections);
-	auto it = _mapConnections.find(index);
-	if(it == _mapConnections.end()) {
+	ConnectionsShard* pShard = shard(index);
+	if (!pShard || !pShard->getConnection(index, pConn)) {
 		ERROR("There is no connection at specified index ", index)
 		return false;
 	}
-
-	pConn = it->second;
 	return true;
 }
 
 void Invoker::removeConnection(unsigned int index) {
-	lock_guard<recursive_mutex>	lock(_mutexConnections);
-	auto it = _mapConnections.find(index);
-	if(it == _mapConnections.end()) {
+	ConnectionsShard* pShard = shard(index);
+	if (!pShard || !pShard->removeConnection(index)) {
 		INFO("Connection at index ", index, " as already been removed")
 		return;
 	}
-
 	INFO("Deleting connection ", index, "...")
-	_mapConnections.erase(it);
 }
 
 void Invoker::terminate() {
-	lock_guard<recursive_mutex>	lock(_mutexConnections);
-
 	Logs::SetDump("");
-	_mapConnections.clear();
+	UInt16 nbShards = _nbShards;
+	for (UInt16 i = 0; i < nbShards; ++i)
+		_shards[i]->clear();
 }
 
-unsigned int Invoker::empty() {
-	lock_guard<recursive_mutex>	lock(_mutexConnections);
-	return _mapConnections.empty();
+void Invoker::terminateIfEmpty() {
+	lock_guard<mutex>	lock(_mutexShards);
+	if (_init && empty())
+		terminate();
 }
 
-void Invoker::manage() {
-	lock_guard<recursive_mutex>	lock(_mutexConnections);
-	auto it = _mapConnections.begin();
-	while(it != _mapConnections.end()) {
-		it->second->manage();
-
-		if (it->second->closed()) {
-			int id = it->first;
-			it++;
-			removeConnection(id);
-			continue;
-		}
-		it++;
+unsigned int Invoker::empty() {
+	UInt16 nbShards = _nbShards;
+	for (UInt16 i = 0; i < nbShards; ++i) {
+		if (_shards[i]->count())
+			return false;
 	}
-
-	if (_init && _mapConnections.empty())
-		terminate();
+	return true;
 }
 
 void Invoker::run(Exception& exc) {
-	Exception exWarn, ex;
+	Exception ex;
 
-	if (!_manager.start(exWarn, Startable::PRIORITY_LOW))
-		ex=exWarn;
-	else if (exWarn)
-		WARN(exWarn.error());
 	while (!ex && sleep() != STOP)
 		giveHandle(ex);
 
 	// terminate the tasks (forced to do immediatly, because no more "giveHandle" is called)
 	TaskHandler::stop();
 
-	_manager.stop();
+	// stop the threads managing the connections
+	UInt16 nbShards = _nbShards;
+	for (UInt16 i = 0; i < nbShards; ++i)
+		_shards[i]->stop();
 
 	if (sockets.running())
 		((Mona::SocketManager&)sockets).stop();
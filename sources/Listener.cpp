@@ -145,7 +145,9 @@ void FlashListener::pushVideo(UInt32 time, const Mona::UInt8* data, Mona::UInt32
 
 	//TRACE("Video time(+seekTime) => ", time, "(+", _seekTime, "), size : ", size);
 
-	if (!writeMedia(*_pVideoWriter, RTMFP::IsKeyFrame(data, size) || _reliable, FlashWriter::VIDEO, _lastTime = (time + _seekTime), data, size))
+	// Codec infos never expire, key frames are useful longer than inter frames
+	UInt32 lifetime(RTMFP::IsH264CodecInfos(data, size) ? 0 : (RTMFP::IsKeyFrame(data, size) ? publication.keyFrameLifetime() : publication.interFrameLifetime()));
+	if (!writeMedia(*_pVideoWriter, RTMFP::IsKeyFrame(data, size) || _reliable, lifetime, FlashWriter::VIDEO, _lastTime = (time + _seekTime), data, size))
 		initWriters();
 }
 
@@ -166,7 +168,8 @@ void FlashListener::pushAudio(UInt32 time, const Mona::UInt8* data, Mona::UInt32
 
 	//TRACE("Audio time(+seekTime) => ", time, "(+", _seekTime, ")");
 
-	if (!writeMedia(*_pAudioWriter, RTMFP::IsAACCodecInfos(data, size) || _reliable, FlashWriter::AUDIO, _lastTime = (time + _seekTime), data, size))
+	UInt32 lifetime(RTMFP::IsAACCodecInfos(data, size) ? 0 : publication.audioLifetime());
+	if (!writeMedia(*_pAudioWriter, RTMFP::IsAACCodecInfos(data, size) || _reliable, lifetime, FlashWriter::AUDIO, _lastTime = (time + _seekTime), data, size))
 		initWriters();
 }
 
@@ -189,10 +192,19 @@ void FlashListener::flush() {
 		_pVideoWriter->flush();
 }
 
-bool FlashListener::writeMedia(FlashWriter& writer, bool reliable, FlashWriter::MediaType type, UInt32 time, const UInt8* data, UInt32 size) {
+UInt32 FlashListener::waiting() const {
+	return (_pAudioWriter ? _pAudioWriter->waiting() : 0) + (_pVideoWriter ? _pVideoWriter->waiting() : 0);
+}
+
+bool FlashListener::writeMedia(FlashWriter& writer, bool reliable, UInt32 lifetime, FlashWriter::MediaType type, UInt32 time, const UInt8* data, UInt32 size) {
 	bool wasReliable(writer.reliable);
+	UInt32 oldLifetime(writer.lifetime);
 	writer.reliable = reliable;
-	bool success(writer.writeMedia(type, time, data, size));
+	writer.lifetime = lifetime;
+	// The payload of the frame is copied once for all the listeners of the publication
+	const shared_ptr<const Buffer>& pPayload(publication.sharedPayload(data, size));
+	bool success(pPayload ? writer.writeSharedMedia(type, time, pPayload) : writer.writeMedia(type, time, data, size));
 	writer.reliable = wasReliable;
+	writer.lifetime = oldLifetime;
 	return success;
 }
@@ -0,0 +1,117 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MediaRing.h"
+#include "Mona/BinaryWriter.h"
+
+using namespace Mona;
+using namespace std;
+
+MediaRing::MediaRing(UInt32 capacity) : _buffer(capacity), _mask(capacity - 1), _writePos(0), _readPos(0) {
+}
+
+bool MediaRing::writeTag(UInt8 type, UInt32 time, const UInt8* data, UInt32 size) {
+	UInt64 position = _writePos.load(memory_order_relaxed);
+	UInt32 total = FLV_TAG_HEADER_SIZE + size + FLV_TAG_FOOTER_SIZE;
+	if (total > capacity() - (UInt32)(position - _readPos.load(memory_order_acquire)))
+		return false;
+
+	UInt8 header[FLV_TAG_HEADER_SIZE];
+	BinaryWriter writer(header, FLV_TAG_HEADER_SIZE);
+	writer.write8(type);
+	// size on 3 bytes
+	writer.write24(size);
+	// time on 3 bytes + extended time
+	writer.write24(time);
+	writer.write8(time >> 24);
+	// stream id on 3 bytes set to 0
+	writer.write24(0);
+	copy(position, header, FLV_TAG_HEADER_SIZE);
+
+	// payload
+	copy(position + FLV_TAG_HEADER_SIZE, data, size);
+
+	// footer
+	UInt8 footer[FLV_TAG_FOOTER_SIZE];
+	BinaryWriter(footer, FLV_TAG_FOOTER_SIZE).write32(FLV_TAG_HEADER_SIZE + size);
+	copy(position + FLV_TAG_HEADER_SIZE + size, footer, FLV_TAG_FOOTER_SIZE);
+
+	_writePos.store(position + total, memory_order_release); // publish the tag
+	return true;
+}
+
+bool MediaRing::write(const UInt8* data, UInt32 size) {
+	UInt64 position = _writePos.load(memory_order_relaxed);
+	if (size > capacity() - (UInt32)(position - _readPos.load(memory_order_acquire)))
+		return false;
+
+	copy(position, data, size);
+	_writePos.store(position + size, memory_order_release); // publish the tags
+	return true;
+}
+
+UInt32 MediaRing::read(UInt8* buffer, UInt32 size) {
+	UInt32 total(0), spanSize;
+	const UInt8* data;
+	while (total < size && (data = span(spanSize))) {
+		if (spanSize > size - total)
+			spanSize = size - total;
+		memcpy(buffer + total, data, spanSize);
+		consume(spanSize);
+		total += spanSize;
+	}
+	return total;
+}
+
+UInt32 MediaRing::peek(UInt32 offset, UInt8* buffer, UInt32 size) const {
+	UInt32 total(0), spanSize;
+	const UInt8* data;
+	while (total < size && (data = span(spanSize, offset + total))) {
+		if (spanSize > size - total)
+			spanSize = size - total;
+		memcpy(buffer + total, data, spanSize);
+		total += spanSize;
+	}
+	return total;
+}
+
+const UInt8* MediaRing::span(UInt32& size, UInt32 from) const {
+	UInt64 position = _readPos.load(memory_order_relaxed) + from;
+	UInt64 end = _writePos.load(memory_order_acquire);
+	size = (position < end) ? (UInt32)(end - position) : 0;
+	if (!size)
+		return NULL;
+	UInt32 offset = (UInt32)position & _mask;
+	if (size > capacity() - offset)
+		size = capacity() - offset; // stop at the end of the ring
+	return _buffer.data() + offset;
+}
+
+void MediaRing::copy(UInt64 position, const UInt8* data, UInt32 size) {
+	UInt32 offset = (UInt32)position & _mask;
+	UInt32 first = capacity() - offset;
+	if (size <= first)
+		memcpy(_buffer.data() + offset, data, size);
+	else {
+		memcpy(_buffer.data() + offset, data, first);
+		memcpy(_buffer.data(), data + first, size - first);
+	}
+}
@@ -34,8 +34,8 @@ using namespace std;
 // Peer instance in the heard list
 class GroupNode : public virtual Object {
 public:
-	GroupNode(const char* rawPeerId, const string& groupId, const PEER_LIST_ADDRESS_TYPE& listAddresses, const SocketAddress& host, UInt64 timeElapsed) :
-		rawId(rawPeerId, PEER_ID_SIZE + 2), groupAddress(groupId), addresses(listAddresses), hostAddress(host), lastGroupReport(((UInt64)Time::Now()) - timeElapsed) {}
+	GroupNode(const char* rawPeerId, const string& groupId, const PEER_LIST_ADDRESS_TYPE& listAddresses, const SocketAddress& host, UInt64 timeElapsed, Int64 now) :
+		rawId(rawPeerId, PEER_ID_SIZE + 2), groupAddress(groupId), addresses(listAddresses), hostAddress(host), lastGroupReport(((UInt64)now) - timeElapsed) {}
 
 	// Return the size of peer addresses for Group Report 
 	UInt32	addressesSize() {
@@ -50,7 +50,8 @@ public:
 	string groupAddress;
 	PEER_LIST_ADDRESS_TYPE addresses;
 	SocketAddress hostAddress;
-	UInt64 lastGroupReport; // Time in msec of last Group report received
+	UInt64 lastGroupReport; // Time in msec of last Group report received (clock of the timer wheel)
+	TimerWheel::Timer timer; // Raise the timeout of the peer (see NetGroup::manageHeardPeer)
 };
 
 const string& NetGroup::GetGroupAddressFromPeerId(const char* rawId, std::string& groupAddress) {
@@ -111,7 +112,7 @@ UInt32 NetGroup::targetNeighborsCount() {
 }
 
 NetGroup::NetGroup(const string& groupId, const string& groupTxt, const string& streamName, RTMFPSession& conn, RTMFPGroupConfig* parameters) : groupParameters(parameters),
-	idHex(groupId), idTxt(groupTxt), stream(streamName), _conn(conn), _pListener(NULL), _groupMediaPublisher(_mapGroupMedias.end()) {
+	idHex(groupId), idTxt(groupTxt), stream(streamName), _conn(conn), _lastReport(conn.timers().now()), _pListener(NULL), _groupMediaPublisher(_mapGroupMedias.end()) {
 	onNewMedia = [this](const string& peerId, shared_ptr<PeerMedia>& pPeerMedia, const string& streamName, const string& streamKey, PacketReader& packet) {
 
 		shared_ptr<RTMFPGroupConfig> pParameters(new RTMFPGroupConfig());
@@ -132,7 +133,7 @@ NetGroup::NetGroup(const string& groupId, const string& groupTxt, const string&
 		// Create the Group Media if it does not exists
 		auto itGroupMedia = _mapGroupMedias.lower_bound(streamKey);
 		if (itGroupMedia == _mapGroupMedias.end() || itGroupMedia->first != streamKey) {
-			itGroupMedia = _mapGroupMedias.emplace_hint(itGroupMedia, piecewise_construct, forward_as_tuple(streamKey), forward_as_tuple(_conn.poolBuffers(), stream, streamKey, pParameters));
+			itGroupMedia = _mapGroupMedias.emplace_hint(itGroupMedia, piecewise_construct, forward_as_tuple(streamKey), forward_as_tuple(_conn.poolBuffers(), _conn.timers(), stream, streamKey, pParameters));
 			itGroupMedia->second.subscribe(onGroupPacket);
 			DEBUG("Creation of GroupMedia ", itGroupMedia->second.id," for the stream ", stream, " :\n", Util::FormatHex(BIN streamKey.data(), streamKey.size(), LOG_BUFFER))
 		}
@@ -205,7 +206,7 @@ NetGroup::NetGroup(const string& groupId, const string& groupTxt, const string&
 		
 		auto itNode = _mapHeardList.find(pPeer->peerId);
 		if (itNode != _mapHeardList.end())
-			itNode->second.lastGroupReport = Time::Now(); // Record the time of last Group Report received to build our Group Report
+			itNode->second.lastGroupReport = _conn.timers().now(); // Record the time of last Group Report received to build our Group Report
 
 		// First Viewer = > create listener
 		if (_groupMediaPublisher != _mapGroupMedias.end() && !_pListener) {
@@ -226,7 +227,7 @@ NetGroup::NetGroup(const string& groupId, const string& groupTxt, const string&
 
 		if (!pPeer->groupReportInitiator) {
 			sendGroupReport(pPeer, false);
-			_lastReport.update();
+			_lastReport = _conn.timers().now();
 		}
 		else
 			pPeer->groupReportInitiator = false;
@@ -249,7 +250,7 @@ NetGroup::NetGroup(const string& groupId, const string& groupTxt, const string&
 			return;
 
 		sendGroupReport(pPeer, true);
-		_lastReport.update();
+		_lastReport = _conn.timers().now();
 	};
 	onGroupPacket = [this](UInt32 time, const UInt8* data, UInt32 size, double lostRate, bool audio) {
 		_conn.pushMedia(stream, time, data, size, lostRate, audio);
@@ -257,6 +258,10 @@ NetGroup::NetGroup(const string& groupId, const string& groupTxt, const string&
 	onPeerClose = [this](const string& peerId) {
 		removePeer(peerId);
 	};
+	_bestListTimer.onTimer = [this](Int64 now) { updateBestList(); };
+	_conn.timers().set(_bestListTimer, _conn.timers().now() + NETGROUP_BEST_LIST_DELAY);
+	_reportTimer.onTimer = [this](Int64 now) { manageReport(now); };
+	_conn.timers().set(_reportTimer, _conn.timers().now() + NETGROUP_REPORT_DELAY);
 
 	GetGroupAddressFromPeerId(STR _conn.rawId(), _myGroupAddress);
 
@@ -270,7 +275,7 @@ NetGroup::NetGroup(const string& groupId, const string& groupTxt, const string&
 
 		shared_ptr<RTMFPGroupConfig> pParameters(new RTMFPGroupConfig());
 		memcpy(pParameters.get(), groupParameters, sizeof(RTMFPGroupConfig)); // TODO: make a initializer
-		_groupMediaPublisher = _mapGroupMedias.emplace(piecewise_construct, forward_as_tuple(streamKey), forward_as_tuple(_conn.poolBuffers(), stream, streamKey, pParameters)).first;
+		_groupMediaPublisher = _mapGroupMedias.emplace(piecewise_construct, forward_as_tuple(streamKey), forward_as_tuple(_conn.poolBuffers(), _conn.timers(), stream, streamKey, pParameters)).first;
 		_groupMediaPublisher->second.subscribe(onGroupPacket);
 	}
 }
@@ -291,6 +296,8 @@ void NetGroup::stopListener() {
 void NetGroup::close() {
 
 	stopListener();
+	_conn.timers().cancel(_bestListTimer);
+	_conn.timers().cancel(_reportTimer);
 
 	for (auto& itGroupMedia : _mapGroupMedias) {
 		itGroupMedia.second.unsubscribe(onGroupPacket);
@@ -312,7 +319,9 @@ void NetGroup::addPeer2HeardList(const string& peerId, const char* rawId, const
 
 	string groupAddress;
 	_mapGroupAddress.emplace(GetGroupAddressFromPeerId(rawId, groupAddress), peerId);
-	it = _mapHeardList.emplace_hint(it, piecewise_construct, forward_as_tuple(peerId.c_str()), forward_as_tuple(rawId, groupAddress, listAddresses, hostAddress, timeElapsed));
+	it = _mapHeardList.emplace_hint(it, piecewise_construct, forward_as_tuple(peerId.c_str()), forward_as_tuple(rawId, groupAddress, listAddresses, hostAddress, timeElapsed, _conn.timers().now()));
+	it->second.timer.onTimer = [this, it](Int64 now) { manageHeardPeer(it, now); };
+	_conn.timers().set(it->second.timer, it->second.lastGroupReport + NETGROUP_PEER_TIMEOUT + 1);
 	DEBUG("Peer ", it->first, " added to heard list")
 }
 
@@ -364,49 +373,42 @@ bool NetGroup::checkPeer(const string& peerId) {
 	return _mapPeers.find(peerId) == _mapPeers.end();
 }
 
-void NetGroup::manage() {
+void NetGroup::manageReport(Int64 now) {
 
-	// Manage the Best list
-	if (_lastBestCalculation.isElapsed(NETGROUP_BEST_LIST_DELAY))
-		updateBestList();
-
-	// Send the Group Report message (0A) to a random connected peer
-	if (_lastReport.isElapsed(NETGROUP_REPORT_DELAY)) {
+	// Send the Group Report message (0A) to a random connected peer (if no report has been sent since NETGROUP_REPORT_DELAY)
+	if (now - _lastReport > NETGROUP_REPORT_DELAY) {
 
 		auto itRandom = _mapPeers.begin();
 		if (RTMFP::getRandomIt<MAP_PEERS_TYPE, MAP_PEERS_ITERATOR_TYPE>(_mapPeers, itRandom, [](const MAP_PEERS_ITERATOR_TYPE it) { return it->second->status == RTMFP::CONNECTED; }))
 			sendGroupReport(itRandom->second.get(), true);
+		_lastReport = now;
+	}
+	_conn.timers().set(_reportTimer, _lastReport + NETGROUP_REPORT_DELAY);
+}
 
-		// Clean the Heard List from old peers
-		Int64 now = Time::Now();
-		auto itHeardList = _mapHeardList.begin();
-		while (itHeardList != _mapHeardList.end()) {
-			if ((_mapPeers.find(itHeardList->first) == _mapPeers.end()) && now > itHeardList->second.lastGroupReport && ((now - itHeardList->second.lastGroupReport) > NETGROUP_PEER_TIMEOUT)) {
-				DEBUG("Peer ", itHeardList->first, " timeout (", NETGROUP_PEER_TIMEOUT, "ms elapsed) - deleting from the heard list...")
-				auto itGroupAddress = _mapGroupAddress.find(itHeardList->second.groupAddress);
-				if (itGroupAddress == _mapGroupAddress.end())
-					WARN("Unable to find peer ", itHeardList->first, " in the map of Group Addresses") // should not happen
-				else
-					_mapGroupAddress.erase(itGroupAddress);
-				_mapHeardList.erase(itHeardList++);
-				continue;
-			}
-			++itHeardList;
-		}
+void NetGroup::manageHeardPeer(map<string, GroupNode>::iterator itNode, Int64 now) {
 
-		_lastReport.update();
+	// Connected peers and peers reported recently are checked again later
+	Int64 deadline = itNode->second.lastGroupReport + NETGROUP_PEER_TIMEOUT;
+	if (_mapPeers.find(itNode->first) != _mapPeers.end() || now <= deadline) {
+		_conn.timers().set(itNode->second.timer, max(deadline, now + NETGROUP_REPORT_DELAY) + 1);
+		return;
 	}
 
-	// Manage all group medias
-	for (auto& itGroupMedia : _mapGroupMedias)
-		itGroupMedia.second.manage();
+	DEBUG("Peer ", itNode->first, " timeout (", NETGROUP_PEER_TIMEOUT, "ms elapsed) - deleting from the heard list...")
+	auto itGroupAddress = _mapGroupAddress.find(itNode->second.groupAddress);
+	if (itGroupAddress == _mapGroupAddress.end())
+		WARN("Unable to find peer ", itNode->first, " in the map of Group Addresses") // should not happen
+	else
+		_mapGroupAddress.erase(itGroupAddress);
+	_mapHeardList.erase(itNode); // (the timer is deleted with the node)
 }
 
 void NetGroup::updateBestList() {
 
 	buildBestList(_myGroupAddress, _bestList);
 	manageBestConnections();
-	_lastBestCalculation.update();
+	_conn.timers().set(_bestListTimer, _conn.timers().now() + NETGROUP_BEST_LIST_DELAY);
 }
 
 void NetGroup::buildBestList(const string& groupAddress, set<string>& bestList) {
@@ -504,7 +506,7 @@ void NetGroup::sendGroupReport(P2PSession* pPeer, bool initiator) {
 
 	// Calculate the total size to allocate sufficient memory
 	UInt32 sizeTotal = (UInt32)(pPeer->peerAddress().host().size() + _conn.serverAddress().host().size() + 12);
-	Int64 timeNow(Time::Now());
+	Int64 timeNow(_conn.timers().now());
 	for (auto it1 : bestList) {
 		itNode = _mapHeardList.find(it1);
 		if (itNode != _mapHeardList.end())
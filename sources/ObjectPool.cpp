@@ -0,0 +1,72 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "ObjectPool.h"
+
+using namespace Mona;
+using namespace std;
+
+mutex					ObjectPools::_Mutex;
+set<ObjectPools::Counters*>	ObjectPools::_Threads;
+ObjectPools::Counters	ObjectPools::_Exited;
+UInt32					ObjectPools::_Peak(0);
+
+// Counters of a running thread, added to the exited counters at the end of the thread
+struct ObjectPools::ThreadCounters : ObjectPools::Counters {
+	ThreadCounters(bool& exited) : _exited(exited) {
+		lock_guard<mutex> lock(_Mutex);
+		_Threads.emplace(this);
+	}
+	~ThreadCounters() {
+		_exited = true;
+		lock_guard<mutex> lock(_Mutex);
+		_Exited.allocations += allocations;
+		_Exited.hits += hits;
+		_Exited.releases += releases;
+		_Threads.erase(this);
+	}
+private:
+	bool& _exited;
+};
+
+ObjectPools::Counters& ObjectPools::Local() {
+	static thread_local bool Exited(false); // (trivially destructible : still readable after the counters)
+	if (Exited)
+		return _Exited;
+	static thread_local ThreadCounters Thread(Exited);
+	return Thread;
+}
+
+void ObjectPools::Read(UInt64& allocations, UInt64& hits, UInt32& peak) {
+	lock_guard<mutex> lock(_Mutex);
+	allocations = _Exited.allocations;
+	hits = _Exited.hits;
+	UInt64 releases = _Exited.releases;
+	for (Counters* pCounters : _Threads) {
+		allocations += pCounters->allocations.load(memory_order_relaxed);
+		hits += pCounters->hits.load(memory_order_relaxed);
+		releases += pCounters->releases.load(memory_order_relaxed);
+	}
+	if (allocations > releases && allocations - releases > _Peak)
+		_Peak = (UInt32)(allocations - releases);
+	peak = _Peak;
+}
@@ -453,6 +453,7 @@ bool P2PSession::createMediaWriter(shared_ptr<RTMFPWriter>& pWriter, UInt64 flow
 	RTMFPWriter* writer = new RTMFPWriter(FlashWriter::OPENED, signature, *_pConnection, flowIdRef);
 	if (_pLastWriter && writer->id == _pLastWriter->id) {
 		pWriter = _pLastWriter;
+		pWriter->priority = WriterScheduler::FRAGMENT; // NetGroup media fragments are sent after the other messages
 		return true;
 	}
 	return false;
@@ -22,13 +22,32 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "PeerMedia.h"
 #include "RTMFPWriter.h"
 #include "P2PSession.h"
+#include "SlidingWindow.h"
 
 using namespace Mona;
 using namespace std;
 
-PeerMedia::PeerMedia(P2PSession* pSession, shared_ptr<RTMFPWriter>& pMediaReportWriter) : _pMediaReportWriter(pMediaReportWriter), _pParent(pSession), _idFragmentsMapIn(0), _idFragmentsMapOut(0), 
-	idFlow(0), idFlowMedia(0), pStreamKey(NULL), _pushOutMode(0), pushInMode(0), groupMediaSent(false), _fragmentsMap(MAX_FRAGMENT_MAP_SIZE) {
+// Return the 64 bits from index (bit 0) of a bitmap starting at the fragment base
+static UInt64 ReadBits(const vector<UInt64>& bitmap, UInt64 base, UInt64 index) {
+	if (bitmap.empty() || index + 63 < base)
+		return 0;
+	if (index < base)
+		return ReadBits(bitmap, base, base) << (base - index);
+
+	UInt64 offset = index - base;
+	size_t word = (size_t)(offset >> 6);
+	UInt8 shift = (UInt8)(offset & 63);
+	if (word >= bitmap.size())
+		return 0;
+	UInt64 result = bitmap[word] >> shift;
+	if (shift && word + 1 < bitmap.size())
+		result |= bitmap[word + 1] << (64 - shift);
+	return result;
+}
 
+PeerMedia::PeerMedia(P2PSession* pSession, shared_ptr<RTMFPWriter>& pMediaReportWriter) : _pMediaReportWriter(pMediaReportWriter), _pParent(pSession), _idFragmentsMapIn(0), _idFragmentsMapOut(0), 
+	idFlow(0), idFlowMedia(0), pStreamKey(NULL), _pushOutMode(0), pushInMode(0), groupMediaSent(false), _mapBase(0), _blacklistBase(0) {
+	_fragmentsMap.reserve(MAX_FRAGMENT_MAP_SIZE / 8);
 }
 
 PeerMedia::~PeerMedia() {
@@ -139,14 +158,41 @@ void PeerMedia::onFragmentsMap(UInt64 id, const UInt8* data, UInt32 size) {
 	}
 
 	_idFragmentsMapIn = id;
-	if (!size)
-		return; // 0 size protection
-
 	if (size > MAX_FRAGMENT_MAP_SIZE)
 		WARN("Size of fragment map > max size : ", size)
-	_fragmentsMap.resize(size);
-	BinaryWriter writer(_fragmentsMap.data(), size);
-	writer.write(data, size);
+
+	// Decode the map : byte n gives the fragments id - 8*n - 1 (bit 0) to id - 8*n - 8 (bit 7), it is read by words of 64 fragments
+	UInt64 first = (id > ((UInt64)size * 8)) ? id - (UInt64)size * 8 : 1;
+	_mapBase = first - (first % 64);
+	_fragmentsMap.assign((size_t)((id - _mapBase) / 64) + 1, 0);
+	_fragmentsMap.back() |= 1ULL << ((id - _mapBase) % 64); // the last fragment is available
+	for (UInt32 offset = 0; offset < size && ((UInt64)offset * 8) < (id - _mapBase); offset += 8) {
+		UInt64 bits = 0;
+		for (UInt8 i = 0; i < 8 && (offset + i) < size; ++i)
+			bits |= ((UInt64)data[offset + i]) << (8 * i);
+		if (!bits)
+			continue;
+
+		// Reversed, bit 0 is the fragment id - offset*8 - 64
+		bits = Bits::Reverse(bits);
+		UInt64 index = id - (UInt64)offset * 8; // (index - 64) is the fragment of bit 0
+		if (index < _mapBase + 64) { // fragments before the bitmap base
+			bits >>= 64 - (index - _mapBase);
+			index = _mapBase + 64;
+		}
+		UInt64 position = index - 64 - _mapBase;
+		UInt8 shift = (UInt8)(position % 64);
+		_fragmentsMap[(size_t)(position / 64)] |= bits << shift;
+		if (shift)
+			_fragmentsMap[(size_t)(position / 64) + 1] |= bits >> (64 - shift);
+	}
+
+	// Delete the old blacklisted fragments
+	if (_blacklistBase < _mapBase && !_blacklistPull.empty()) {
+		size_t oldWords = (size_t)min<UInt64>((_mapBase - _blacklistBase) / 64, _blacklistPull.size());
+		_blacklistPull.erase(_blacklistPull.begin(), _blacklistPull.begin() + oldWords);
+		_blacklistBase += (UInt64)oldWords * 64;
+	}
 }
 
 void PeerMedia::onFragment(UInt8 marker, UInt64 id, UInt8 splitedNumber, UInt8 mediaType, UInt32 time, PacketReader& packet, double lostRate) {
@@ -164,10 +210,9 @@ bool PeerMedia::checkMask(UInt8 bitNumber) {
 	UInt64 lastFragment = _idFragmentsMapIn - (_idFragmentsMapIn % 8);
 	lastFragment += ((_idFragmentsMapIn % 8) > bitNumber) ? bitNumber : bitNumber - 8;
 
-	DEBUG("Searching ", lastFragment, " into ", Format<UInt8>("%.2x", *_fragmentsMap.data()), " ; (current id : ", _idFragmentsMapIn, ") ; result = ",
-		((*_fragmentsMap.data()) & (1 << (8 - _idFragmentsMapIn + lastFragment))) > 0, " ; bit : ", bitNumber, " ; address : ", _pParent->peerId, " ; latency : ", _pParent->latency())
-
-	return ((*_fragmentsMap.data()) & (1 << (8 - _idFragmentsMapIn + lastFragment))) > 0;
+	bool result = (ReadBits(_fragmentsMap, _mapBase, lastFragment) & 1) != 0;
+	DEBUG("Searching ", lastFragment, " (current id : ", _idFragmentsMapIn, ") ; result = ", result, " ; bit : ", bitNumber, " ; address : ", _pParent->peerId, " ; latency : ", _pParent->latency())
+	return result;
 }
 
 bool PeerMedia::hasFragment(UInt64 index) {
@@ -179,22 +224,28 @@ bool PeerMedia::hasFragment(UInt64 index) {
 		TRACE("Searching ", index, " OK into ", _pParent->peerId, ", current id : ", _idFragmentsMapIn)
 		return true; // Fragment is the last one or peer has all fragments
 	}
-	else if (_blacklistPull.find(index) != _blacklistPull.end()) {
+	else if (ReadBits(_blacklistPull, _blacklistBase, index) & 1) {
 		TRACE("Searching ", index, " impossible into ", _pParent->peerId, " a request has already failed")
 		return false;
 	}
-
-	UInt32 offset = (UInt32)((_idFragmentsMapIn - index - 1) / 8);
-	UInt32 rest = ((_idFragmentsMapIn - index - 1) % 8);
-	if (offset > _fragmentsMap.size()) {
-		TRACE("Searching ", index, " impossible into ", _pParent->peerId, ", out of buffer (", offset, "/", _fragmentsMap.size(), ")")
+	else if (index < _mapBase) {
+		TRACE("Searching ", index, " impossible into ", _pParent->peerId, ", out of buffer (first fragment : ", _mapBase, ")")
 		return false; // Fragment deleted from buffer
 	}
 
-	TRACE("Searching ", index, " into ", Format<UInt8>("%.2x", *(_fragmentsMap.data() + offset)), " ; (current id : ", _idFragmentsMapIn, ", offset : ", offset, ") ; result = ",
-		(*(_fragmentsMap.data() + offset) & (1 << rest)) > 0)
+	bool result = (ReadBits(_fragmentsMap, _mapBase, index) & 1) != 0;
+	TRACE("Searching ", index, " (current id : ", _idFragmentsMapIn, ") ; result = ", result)
+	return result;
+}
+
+UInt64 PeerMedia::availableFragments(UInt64 index) {
+	if (!_idFragmentsMapIn || (_idFragmentsMapIn < index))
+		return 0;
 
-	return (*(_fragmentsMap.data() + offset) & (1 << rest)) > 0;
+	UInt64 result = ReadBits(_fragmentsMap, _mapBase, index) & ~ReadBits(_blacklistPull, _blacklistBase, index);
+	if (_idFragmentsMapIn - index < 64)
+		result |= 1ULL << (_idFragmentsMapIn - index); // the last fragment is always available
+	return result;
 }
 
 void PeerMedia::onPlayPull(UInt64 index) {
@@ -211,6 +262,15 @@ void PeerMedia::sendPull(UInt64 index) {
 }
 
 void PeerMedia::addPullBlacklist(UInt64 idFragment) {
-	// TODO: delete old blacklisted fragments
-	_blacklistPull.emplace(idFragment);
+	UInt64 base = idFragment - (idFragment % 64);
+	if (_blacklistPull.empty())
+		_blacklistBase = base;
+	else if (base < _blacklistBase) {
+		_blacklistPull.insert(_blacklistPull.begin(), (size_t)((_blacklistBase - base) / 64), 0);
+		_blacklistBase = base;
+	}
+	size_t word = (size_t)((base - _blacklistBase) / 64);
+	if (word >= _blacklistPull.size())
+		_blacklistPull.resize(word + 1, 0);
+	_blacklistPull[word] |= 1ULL << (idFragment % 64); // old fragments are deleted when receiving the fragments map
 }
@@ -29,9 +29,9 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 using namespace Mona;
 using namespace std;
 
-Publisher::Publisher(const string& name, Invoker& invoker, bool audioReliable, bool videoReliable, bool p2p) : _running(false), _new(false), _name(name), publishAudio(true), publishVideo(true),
-	_audioReliable(audioReliable), _videoReliable(videoReliable), _audioCodecBuffer(invoker.poolBuffers), _videoCodecBuffer(invoker.poolBuffers), isP2P(p2p),
-	_pos(0), _invoker(invoker), Task((TaskHandler&)invoker) {
+Publisher::Publisher(const string& name, const PoolBuffers& poolBuffers, bool audioReliable, bool videoReliable, bool p2p) : _running(false), _new(false), _name(name), publishAudio(true), publishVideo(true),
+	_audioReliable(audioReliable), _videoReliable(videoReliable), _audioLifetime(RTMFP_AUDIO_LIFETIME), _keyFrameLifetime(RTMFP_KEYFRAME_LIFETIME), _interFrameLifetime(RTMFP_INTERFRAME_LIFETIME), _audioCodecBuffer(poolBuffers), _videoCodecBuffer(poolBuffers), isP2P(p2p),
+	_queue(RTMFP_PUBLISH_QUEUE_SIZE), _frame(NULL), _frameSize(0) {
 
 	INFO("Initialization of the publisher ", _name, " (audioReliable : ", _audioReliable, " - videoReliable : ", _videoReliable, ")")
 }
@@ -90,19 +90,111 @@ void Publisher::stop() {
 }
 
 bool Publisher::publish(const Mona::UInt8* data, Mona::UInt32 size, int& pos) {
-	_reader.reset(new PacketReader(data, size));
-	_pos = pos;
-	if (_reader->available()<14) {
-		DEBUG("Packet too small")
-		return true;
+	UInt32 begin(0);
+	if (size >= 3 && memcmp(data, "FLV", 3) == 0) { // header
+		if (size < 13)
+			return true; // we will wait for further data
+		begin = 13;
 	}
 
-	// Wait for packets to be sent
-	waitHandle();
-	pos = _pos; // update the position
+	// Search the complete tags which fit in the queue
+	UInt32 space(_queue.space()), end(begin);
+	while (size - end >= FLV_TAG_HEADER_SIZE) {
+		UInt32 bodySize = BinaryReader(data + end + 1, 3).read24();
+		UInt32 tagSize = FLV_TAG_HEADER_SIZE + bodySize + FLV_TAG_FOOTER_SIZE;
+		if (size - end < tagSize)
+			break; // we will wait for further data
+		if (tagSize > _queue.capacity()) {
+			ERROR("FLV tag of ", bodySize, " bytes is larger than the publication queue of ", _name)
+			return false;
+		}
+		UInt32 sizeBis = BinaryReader(data + end + tagSize - FLV_TAG_FOOTER_SIZE, FLV_TAG_FOOTER_SIZE).read32();
+		if (sizeBis != bodySize + 11) {
+			ERROR("Unexpected size found after payload : ", sizeBis, " (expected: ", bodySize + 11, ")")
+			if (end == begin)
+				return false;
+			break; // the valid tags before are queued, the error will be returned by the next call
+		}
+		if (end - begin + tagSize > space) {
+			DEBUG("Publication queue of ", _name, " is full, ", size - end, " bytes are left to the caller")
+			break;
+		}
+		end += tagSize;
+	}
+
+	// Copy them in one block (the queue can't be full, we are the only producer)
+	if (end > begin)
+		_queue.write(data + begin, end - begin);
+	pos = end;
 	return true;
 }
 
+bool Publisher::publish(UInt8 type, UInt32 time, const UInt8* data, UInt32 size, bool& queued) {
+	queued = false;
+	if (type != AMF::AUDIO && type != AMF::VIDEO) {
+		ERROR("Unexpected frame type published on ", _name, " : ", type)
+		return false;
+	}
+	if (FLV_TAG_HEADER_SIZE + size + FLV_TAG_FOOTER_SIZE > _queue.capacity()) {
+		ERROR("Frame of ", size, " bytes is larger than the publication queue of ", _name)
+		return false;
+	}
+
+	// The tag header is written by the queue, the payload is copied once
+	queued = _queue.writeTag(type, time, data, size);
+	return true;
+}
+
+void Publisher::drain(bool force) {
+	UInt32 size;
+	const UInt8* data;
+	while ((data = _queue.span(size)) && (force || !congested())) {
+
+		// Tag contiguous in the queue : push it in place
+		if (size >= FLV_TAG_HEADER_SIZE) {
+			UInt32 tagSize = FLV_TAG_HEADER_SIZE + BinaryReader(data + 1, 3).read24() + FLV_TAG_FOOTER_SIZE;
+			if (size >= tagSize) {
+				pushTag(data);
+				_queue.consume(tagSize);
+				continue;
+			}
+		}
+
+		// Tag wrapping around the end of the queue : copy it
+		_tag.resize(FLV_TAG_HEADER_SIZE, false);
+		_queue.read(_tag.data(), FLV_TAG_HEADER_SIZE);
+		UInt32 bodySize = BinaryReader(_tag.data() + 1, 3).read24();
+		_tag.resize(FLV_TAG_HEADER_SIZE + bodySize + FLV_TAG_FOOTER_SIZE, true);
+		_queue.read(_tag.data() + FLV_TAG_HEADER_SIZE, bodySize + FLV_TAG_FOOTER_SIZE);
+		pushTag(_tag.data());
+	}
+	flush();
+}
+
+bool Publisher::congested() const {
+	for (auto& it : _listeners) {
+		if (it.second->waiting() > RTMFP_PUBLISH_MAX_WAITING)
+			return true;
+	}
+	return false;
+}
+
+void Publisher::pushTag(const UInt8* tag) {
+	BinaryReader reader(tag, FLV_TAG_HEADER_SIZE);
+	UInt8 type = reader.read8();
+	UInt32 bodySize = reader.read24();
+	UInt32 time = reader.read24();
+	time |= (UInt32)reader.read8() << 24; // extended time
+
+	//TRACE(((type == 0x08) ? "Audio" : ((type == 0x09) ? "Video" : "Unknown")), " packet read - size : ", bodySize, " - time : ", time)
+	if (type == AMF::AUDIO)
+		pushAudio(time, tag + FLV_TAG_HEADER_SIZE, bodySize);
+	else if (type == AMF::VIDEO)
+		pushVideo(time, tag + FLV_TAG_HEADER_SIZE, bodySize);
+	else
+		WARN("Unhandled packet type : ", type)
+}
+
 void Publisher::pushAudio(UInt32 time, const UInt8* data, UInt32 size) {
 	if (!_running) {
 		ERROR("Audio packet pushed on '", _name, "' publication stopped");
@@ -124,10 +216,16 @@ void Publisher::pushAudio(UInt32 time, const UInt8* data, UInt32 size) {
 	}
 
 	_new = true;
+	if (_listeners.size() > 1) {
+		_frame = data;
+		_frameSize = size;
+	}
 	auto it = _listeners.begin();
 	while (it != _listeners.end()) {
 		(it++)->second->pushAudio(time, data, size);  // listener can be removed in this call
 	}
+	_frame = NULL;
+	_pPayload.reset(); // the writers keep their reference until the message is acknowledged
 }
 
 void Publisher::pushVideo(UInt32 time, const UInt8* data, UInt32 size) {
@@ -162,10 +260,28 @@ void Publisher::pushVideo(UInt32 time, const UInt8* data, UInt32 size) {
 	}*/
 
 	_new = true;
+	if (_listeners.size() > 1) {
+		_frame = data;
+		_frameSize = size;
+	}
 	auto it = _listeners.begin();
 	while (it != _listeners.end()) {
 		(it++)->second->pushVideo(time, data, size); // listener can be removed in this call
 	}
+	_frame = NULL;
+	_pPayload.reset(); // the writers keep their reference until the message is acknowledged
+}
+
+const shared_ptr<const Buffer>& Publisher::sharedPayload(const UInt8* data, UInt32 size) const {
+	static const shared_ptr<const Buffer> Null;
+	if (!_frame || data != _frame || size != _frameSize)
+		return Null;
+	if (!_pPayload) {
+		Buffer* pPayload = new Buffer(size);
+		memcpy(pPayload->data(), data, size);
+		_pPayload.reset(pPayload);
+	}
+	return _pPayload;
 }
 
 void Publisher::flush() {
@@ -176,44 +292,3 @@ void Publisher::flush() {
 	for (it = _listeners.begin(); it != _listeners.end(); ++it)
 		it->second->flush();
 }
-
-void Publisher::handle(Exception& ex) { 
-	if (!_reader)
-		return; // TODO: shouldn't happen
-
-	const UInt8* cur = _reader->current();
-	if (*cur == 'F' && *(++cur) == 'L' && *(++cur) == 'V') { // header
-		_reader->next(13);
-		_pos = 13;
-	}
-
-	// Send all packets
-	while (_reader->available()) {
-		if (_reader->available() < 11) // smaller than flv header
-			break;
-
-		UInt8 type = _reader->read8();
-		UInt32 bodySize = _reader->read24();
-		UInt32 time = _reader->read24();
-		_reader->next(4); // ignored
-
-		if (_reader->available() < bodySize + 4)
-			break; // we will wait for further data
-
-		//TRACE(((type == 0x08) ? "Audio" : ((type == 0x09) ? "Video" : "Unknown")), " packet read - size : ", bodySize, " - time : ", time)
-		if (type == AMF::AUDIO)
-			pushAudio(time, _reader->current(), bodySize);
-		else if (type == AMF::VIDEO)
-			pushVideo(time, _reader->current(), bodySize);
-		else
-			WARN("Unhandled packet type : ", type)
-		_reader->next(bodySize);
-		UInt32 sizeBis = _reader->read32();
-		_pos += bodySize + 15;
-		if (sizeBis != bodySize + 11) {
-			ERROR("Unexpected size found after payload : ", sizeBis, " (expected: ", bodySize + 11, ")")
-			break;
-		}
-	}
-	flush();
-}
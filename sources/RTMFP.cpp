@@ -25,6 +25,86 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 using namespace std;
 using namespace Mona;
 
+#define RTMFP_CODEC_BLOCK_SIZE	256 // number of bytes decrypted before being summed (to stay in cache)
+
+RTMFPEngine::RTMFPEngine(const UInt8* key, Direction direction) : _direction(direction) {
+	EVP_CIPHER_CTX_init(&_context);
+	// The key schedule is computed once, then only the IV is reset for each packet
+	EVP_CipherInit_ex(&_context, EVP_aes_128_cbc(), NULL, key, NULL, _direction);
+	EVP_CIPHER_CTX_set_padding(&_context, 0); // packets are already padded
+}
+
+RTMFPEngine::~RTMFPEngine() {
+	EVP_CIPHER_CTX_cleanup(&_context);
+}
+
+bool RTMFPEngine::process(UInt8* data, int size) {
+	if (size < 2)
+		return false;
+
+	static const UInt8 IV[RTMFP_KEY_SIZE] = { 0 };
+	EVP_CipherInit_ex(&_context, NULL, NULL, NULL, IV, -1);
+	int newSize(size);
+
+	if (_direction == ENCRYPT) {
+		// The CRC is in the first block so it is computed before the encryption
+		BinaryWriter(data, 2).write16(ComputeCRC(data + 2, size - 2));
+		EVP_CipherUpdate(&_context, data, &newSize, data, size);
+		return true;
+	}
+
+	// Decrypt block by block and sum the words of each block while it is in cache
+	UInt32 end = 2 + ((UInt32)(size - 2) & ~1); // end of the 16-bit words
+	UInt64 sum(0);
+	for (UInt32 offset = 0; offset < (UInt32)size; offset += RTMFP_CODEC_BLOCK_SIZE) {
+		UInt32 blockEnd = min<UInt32>(offset + RTMFP_CODEC_BLOCK_SIZE, size);
+		EVP_CipherUpdate(&_context, data + offset, &newSize, data + offset, blockEnd - offset);
+
+		UInt32 first = max<UInt32>(offset, 2), last = min<UInt32>(blockEnd, end);
+		if (last > first)
+			sum = AddWords(data + first, last - first, sum);
+	}
+	return FinalizeCRC(sum, (end < (UInt32)size) ? data + end : NULL) == BinaryReader(data, 2).read16();
+}
+
+UInt16 RTMFPEngine::ComputeCRC(const UInt8* data, UInt32 size) {
+	return FinalizeCRC(AddWords(data, size & ~1, 0), (size & 1) ? data + size - 1 : NULL);
+}
+
+UInt64 RTMFPEngine::AddWords(const UInt8* data, UInt32 size, UInt64 sum) {
+	// Each 64-bit load is added as two 32-bit halves, carries are kept in the upper bits of sum
+	UInt64 value;
+	for (; size >= 8; data += 8, size -= 8) {
+		memcpy(&value, data, 8);
+		sum += (value & 0xFFFFFFFF) + (value >> 32);
+	}
+	if (size) {
+		value = 0;
+		memcpy(&value, data, size);
+		sum += (value & 0xFFFFFFFF) + (value >> 32);
+	}
+	return sum;
+}
+
+UInt16 RTMFPEngine::FinalizeCRC(UInt64 sum, const UInt8* pLastByte) {
+	// Fold the carries (end-around carry)
+	while (sum >> 16)
+		sum = (sum & 0xFFFF) + (sum >> 16);
+
+	// Words have been read in the native byte order, a one's complement sum just needs to be swapped
+	static const UInt16 Endianness(1);
+	UInt16 result = (UInt16)sum;
+	if (*(const UInt8*)&Endianness) // little endian
+		result = (UInt16)((result >> 8) | (result << 8));
+
+	// Odd size : the last byte is added without shifting
+	if (pLastByte) {
+		UInt32 total = result + *pLastByte;
+		result = (UInt16)((total & 0xFFFF) + (total >> 16));
+	}
+	return (UInt16)~result;
+}
+
 bool RTMFP::ReadAddress(BinaryReader& reader, SocketAddress& address, UInt8 addressType) {
 	string data;
 	reader.read<string>((addressType & 0x80) ? sizeof(in6_addr) : sizeof(in_addr), data);
@@ -28,7 +28,7 @@ using namespace Mona;
 using namespace std;
 
 RTMFPConnection::RTMFPConnection(const Mona::SocketAddress& address, SocketHandler* pHandler, FlowManager* session, bool responder, bool p2p) : 
-	Connection(pHandler), _pSession(session), _responder(responder), _nonce(0x4C), _isP2P(p2p), _connectAttempt(0) {
+	Connection(pHandler), _pSession(session), _responder(responder), _nonce(0x4C), _isP2P(p2p), _connectAttempt(0), _nearId(0) {
 
 	_address.set(address);
 }
@@ -87,6 +87,7 @@ void RTMFPConnection::handleMessage(const PoolBuffer& pBuffer) {
 	case 0xFA:
 		if (_status < RTMFP::CONNECTED) {
 			_status = RTMFP::CONNECTED;
+			wakeUp(); // start the ping and send the waiting messages
 			_pParent->onConnection(_address, _pSession->name());
 		}
 		OnMessage::raise(reader);
@@ -161,19 +162,24 @@ void RTMFPConnection::manage() {
 	case RTMFP::HANDSHAKE30:
 	case RTMFP::STOPPED: 
 		// Send First handshake request (30)
-		if (!(_pSession->status > RTMFP::HANDSHAKE30) && (!_connectAttempt || _lastAttempt.isElapsed(_connectAttempt*1500))) {
-			if (_connectAttempt++ == 11) {
-				DEBUG("Connection to ", name(), " has reached 11 attempt without answer, closing...")
-				_status = RTMFP::FAILED;
-				_pSession->unsubscribeConnection(_address);
-				return;
+		if (!(_pSession->status > RTMFP::HANDSHAKE30)) {
+			bool attempt = !_connectAttempt || _lastAttempt.isElapsed(_connectAttempt*1500);
+			if (attempt) {
+				if (_connectAttempt++ == 11) {
+					DEBUG("Connection to ", name(), " has reached 11 attempt without answer, closing...")
+					_status = RTMFP::FAILED;
+					_pSession->unsubscribeConnection(_address);
+					return;
+				}
+				TRACE("Sending new handshake 30 to ", _pSession->name(), " at address ", _address.toString())
+				sendHandshake30(_pSession->epd(), _pSession->tag());
+				if (_pSession->status == RTMFP::STOPPED)
+					_pSession->status = RTMFP::HANDSHAKE30;
+				_lastAttempt.update();
 			}
-			TRACE("Sending new handshake 30 to ", _pSession->name(), " at address ", _address.toString())
-			sendHandshake30(_pSession->epd(), _pSession->tag());
-			if (_pSession->status == RTMFP::STOPPED)
-				_pSession->status = RTMFP::HANDSHAKE30;
-			_lastAttempt.update();
-			break;
+			_pTimers->anticipate(_timer, _pTimers->now() + _connectAttempt*1500 - _lastAttempt.elapsed()); // next attempt
+			if (attempt)
+				break;
 		}
 	default:
 		return; // don't manage other connections
@@ -313,6 +319,13 @@ void RTMFPConnection::handleHandshake70(BinaryReader& reader) {
 		close(); // destroy the connection
 }
 
+void RTMFPConnection::setNearId(UInt32 nearId) {
+	if (_nearId == nearId)
+		return;
+	_nearId = nearId;
+	_pParent->updateConnections(); // index the new id
+}
+
 void RTMFPConnection::sendHandshake38(const string& farKey, const string& cookie) {
 	if (!farKey.empty())
 		_farKey = farKey;
@@ -322,6 +335,7 @@ void RTMFPConnection::sendHandshake38(const string& farKey, const string& cookie
 	writer.clear(RTMFP_HEADER_SIZE + 3); // header + type and size
 
 	writer.write32(0x02000000); // id
+	setNearId(0x02000000);
 
 	writer.write7BitLongValue(cookie.size());
 	writer.write(cookie); // Resend cookie
@@ -431,6 +445,7 @@ void RTMFPConnection::sendHandshake78(BinaryReader& reader) {
 	writer.clear(RTMFP_HEADER_SIZE + 3); // header + type and size
 
 	writer.write32(_pSession->sessionId()); // TODO: see if we need to do a << 24
+	setNearId(_pSession->sessionId());
 	writer.write8(0x49); // nonce is 73 bytes long
 	BinaryWriter nonceWriter(_nonce.data(), 0x49);
 	nonceWriter.write(EXPAND("\x03\x1A\x00\x00\x02\x1E\x00\x41\x0E"));
@@ -487,6 +502,7 @@ void RTMFPConnection::sendConnect(BinaryReader& reader) {
 		return;
 
 	_status = RTMFP::CONNECTED;
+	wakeUp(); // start the ping and send the waiting messages
 	_pParent->onConnection(_address, _pSession->name());
 }
 
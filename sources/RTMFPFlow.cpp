@@ -30,7 +30,9 @@ using namespace Mona;
 
 class RTMFPPacket : public virtual Object {
 public:
-	RTMFPPacket(const PoolBuffers& poolBuffers,PacketReader& fragment) : fragments(1),_pMessage(NULL),_pBuffer(poolBuffers,fragment.available()) {
+	// capacity : size of the message if known (to append the next fragments without reallocation)
+	RTMFPPacket(const PoolBuffers& poolBuffers,PacketReader& fragment,UInt32 capacity=0) : fragments(1),_pMessage(NULL),_pBuffer(poolBuffers,capacity>fragment.available() ? capacity : fragment.available()) {
+		_pBuffer->resize(fragment.available()); // capacity is kept
 		if(_pBuffer->size()>0)
 			memcpy(_pBuffer->data(),fragment.current(),_pBuffer->size());
 	}
@@ -62,23 +64,24 @@ private:
 };
 
 
-class RTMFPFragment : public PoolBuffer, public virtual Object{
+// Fragment received before its turn (slot of the reordering window, the buffer is reused by the next stages)
+class RTMFPFragment : public virtual Object {
 public:
-	RTMFPFragment(const PoolBuffers& poolBuffers,PacketReader& packet,UInt8 flags) : flags(flags),PoolBuffer(poolBuffers,packet.available()) {
-		packet.read((*this)->size(),(*this)->data());
-	}
+	RTMFPFragment() : flags(0) {}
+
+	Buffer					buffer;
 	UInt8					flags;
 };
 
 
 RTMFPFlow::RTMFPFlow(UInt64 id,const string& signature,const PoolBuffers& poolBuffers, BandWriter& band, const shared_ptr<FlashConnection>& pMainStream, UInt64 idWriterRef) : _pStream(pMainStream),
-	_poolBuffers(poolBuffers),_numberLostFragments(0),id(id),_writerRef(idWriterRef),_stage(0),_completed(false),_pPacket(NULL),_band(band) {
+	_poolBuffers(poolBuffers),_numberLostFragments(0),id(id),_writerRef(idWriterRef),_stage(0),_completed(false),_pPacket(NULL),_band(band),_packetsToAck(0),_fragments(RTMFP_REORDER_DEPTH),_reorderBytes(0),_reorderDepth(0),_ackTime(0),_completeTime(0) {
 
 	DEBUG("New main flow ", id, " on connection ", band.name())
 }
 
 RTMFPFlow::RTMFPFlow(UInt64 id,const string& signature,const shared_ptr<FlashStream>& pStream,const PoolBuffers& poolBuffers, BandWriter& band, UInt64 idWriterRef) : _pStream(pStream),_poolBuffers(poolBuffers),
-	_numberLostFragments(0),id(id),_writerRef(idWriterRef),_stage(0),_completed(false),_pPacket(NULL),_band(band) {
+	_numberLostFragments(0),id(id),_writerRef(idWriterRef),_stage(0),_completed(false),_pPacket(NULL),_band(band),_packetsToAck(0),_fragments(RTMFP_REORDER_DEPTH),_reorderBytes(0),_reorderDepth(0),_ackTime(0),_completeTime(0) {
 
 	DEBUG("New flow ", id, " on connection ", band.name())
 }
@@ -95,8 +98,9 @@ void RTMFPFlow::complete() {
 
 	DEBUG("RTMFPFlow ",id," completed");
 
-	// delete fragments
+	// delete fragments (buffers are kept by the window)
 	_fragments.clear();
+	_reorderBytes = 0;
 
 	// delete receive buffer
 	if(_pPacket) {
@@ -105,7 +109,7 @@ void RTMFPFlow::complete() {
 	}
 
 	_completed=true;
-	_completeTime.update();
+	_completeTime = _band.timers().now();
 }
 
 void RTMFPFlow::fail(const string& error) {
@@ -120,22 +124,44 @@ void RTMFPFlow::close() {
 	writer.write7BitLongValue(id);
 	writer.write8(0); // finishing marker
 	//_band.flush();
+	_band.wakeUp();
+}
+
+Int64 RTMFPFlow::deadline(UInt32 ackDelay) const {
+	if (_packetsToAck)
+		return _ackTime + ackDelay + 1; // see ackElapsed()
+	if (_completed)
+		return _completeTime + 120001; // see consumed()
+	return 0;
+}
+
+bool RTMFPFlow::commit(UInt32 maxPackets) {
+	if (!_packetsToAck++)
+		_ackTime = _band.timers().now();
+
+	// Without lost stages the acknowledgment can wait for the next packet sent or the ack delay
+	if (_fragments.empty() && !_completed && _packetsToAck < maxPackets)
+		return false;
+
+	writeAck();
+	_band.flush();
+	return true;
 }
 
-void RTMFPFlow::commit() {
+bool RTMFPFlow::writeAck(UInt32 maxSize) {
 
 	// Lost informations!
 	UInt32 size = 0;
 	vector<UInt64> losts;
 	UInt64 current=_stage;
 	UInt32 count=0;
-	auto it = _fragments.begin();
-	while(it!=_fragments.end()) {
-		current = it->first-current-2;
+	UInt64 index = _fragments.first();
+	while(index) {
+		current = index-current-2;
 		size += Util::Get7BitValueSize(current);
 		losts.emplace_back(current);
-		current = it->first;
-		while(++it!=_fragments.end() && it->first==(++current))
+		current = index;
+		while((index = _fragments.next(index)) && index==(++current))
 			++count;
 		size += Util::Get7BitValueSize(count);
 		losts.emplace_back(count);
@@ -144,7 +170,11 @@ void RTMFPFlow::commit() {
 	}
 
 	UInt32 bufferSize = _pPacket ? ((_pPacket->fragments>0x3F00) ? 0 : (0x3F00-_pPacket->fragments)) : 0x7F;
-	BinaryWriter& ack = _band.writeMessage(0x51,Util::Get7BitValueSize(id)+Util::Get7BitValueSize(bufferSize)+Util::Get7BitValueSize(_stage)+size);
+	size += Util::Get7BitValueSize(id)+Util::Get7BitValueSize(bufferSize)+Util::Get7BitValueSize(_stage);
+	if ((size + 3) > maxSize)
+		return false;
+
+	BinaryWriter& ack = _band.writeMessage(0x51,size);
 
 	ack.write7BitLongValue(id);
 	ack.write7BitValue(bufferSize);
@@ -153,7 +183,8 @@ void RTMFPFlow::commit() {
 	for(UInt64 lost : losts)
 		ack.write7BitLongValue(lost);
 
-	_band.flush();
+	_packetsToAck = 0;
+	return true;
 }
 
 void RTMFPFlow::receive(UInt64 stage,UInt64 deltaNAck,PacketReader& fragment,UInt8 flags) {
@@ -173,18 +204,10 @@ void RTMFPFlow::receive(UInt64 stage,UInt64 deltaNAck,PacketReader& fragment,UIn
 	}
 	
 	if(_stage < (stage-deltaNAck)) {
-		auto it=_fragments.begin();
-		while(it!=_fragments.end()) {
-			if( it->first > stage) 
-				break;
-			// leave all stages <= _stage
-			PacketReader packet(it->second->data(),it->second->size());
-			onFragment(it->first,packet,it->second.flags);
-			if(_completed || it->second.flags&MESSAGE_END) {
-				complete();
-				return; // to prevent a crash bug!! (double fragments deletion)
-			}
-			_fragments.erase(it++);
+		// leave all stages <= stage
+		while(!_fragments.empty() && _fragments.first() <= stage) {
+			if(!onBufferedFragment())
+				return;
 		}
 
 		nextStage = stage;
@@ -192,34 +215,58 @@ void RTMFPFlow::receive(UInt64 stage,UInt64 deltaNAck,PacketReader& fragment,UIn
 	
 	if(stage>nextStage) {
 		// not following _stage, bufferizes the _stage
-		auto it = _fragments.lower_bound(stage);
-		if(it==_fragments.end() || it->first!=stage) {
-			_fragments.emplace_hint(it,piecewise_construct,forward_as_tuple(stage),forward_as_tuple(_poolBuffers,fragment,flags));
-			if(_fragments.size()>100)
-				DEBUG("_fragments.size()=",_fragments.size());
-		} else
-			DEBUG("Stage ",stage," on flow ",id," has already been received");
+		RTMFPFragment* pFragment(NULL);
+		if(_fragments.has(stage))
+			DEBUG("Stage ",stage," on flow ",id," has already been received")
+		else if((stage-_stage)>RTMFP_REORDER_DEPTH || (_reorderBytes+fragment.available())>RTMFP_REORDER_BUDGET || !(pFragment = _fragments.add(stage)))
+			DEBUG("Stage ",stage," on flow ",id," ignored, reordering buffer is full (",_fragments.count()," fragments, ",_reorderBytes," bytes)") // not acknowledged => will be repeated
+		else {
+			pFragment->flags = flags;
+			pFragment->buffer.resize(fragment.available(), false); // capacity is kept between stages
+			fragment.read(pFragment->buffer.size(), pFragment->buffer.data());
+			_reorderBytes += pFragment->buffer.size();
+			if((stage-_stage)>_reorderDepth)
+				_reorderDepth = (UInt32)(stage-_stage);
+		}
 	} else {
 		onFragment(nextStage++,fragment,flags);
 		if(flags&MESSAGE_END)
 			complete();
-		auto it=_fragments.begin();
-		while(it!=_fragments.end()) {
-			if( it->first > nextStage)
-				break;
-			PacketReader packet(it->second->data(), it->second->size());
-			onFragment(nextStage++,packet,it->second.flags);
-			if(_completed || it->second.flags&MESSAGE_END) {
-				complete();
-				return; // to prevent a crash bug!! (double fragments deletion)
-			}
-			_fragments.erase(it++);
+		while(!_fragments.empty() && _fragments.first() == nextStage) {
+			if(!onBufferedFragment())
+				return;
+			++nextStage;
 		}
 
 	}
 }
 
-void RTMFPFlow::onFragment(UInt64 stage,PacketReader& fragment,UInt8 flags) {
+bool RTMFPFlow::onBufferedFragment() {
+	UInt64 stage = _fragments.first();
+	RTMFPFragment& fragment(*_fragments.get(stage));
+
+	// First fragment of a message : the following fragments received give the size to allocate
+	UInt32 messageSize(0);
+	if((fragment.flags&MESSAGE_WITH_AFTERPART) && !(fragment.flags&MESSAGE_WITH_BEFOREPART)) {
+		UInt64 index = stage;
+		RTMFPFragment* pNext(&fragment);
+		do {
+			messageSize += pNext->buffer.size();
+		} while((pNext->flags&MESSAGE_WITH_AFTERPART) && (pNext = _fragments.get(++index)));
+	}
+
+	PacketReader packet(fragment.buffer.data(), fragment.buffer.size());
+	onFragment(stage,packet,fragment.flags,messageSize);
+	if(_completed || fragment.flags&MESSAGE_END) {
+		complete();
+		return false;
+	}
+	_reorderBytes -= fragment.buffer.size();
+	_fragments.remove(stage);
+	return true;
+}
+
+void RTMFPFlow::onFragment(UInt64 stage,PacketReader& fragment,UInt8 flags,UInt32 messageSize) {
 	if(stage<=_stage) {
 		ERROR("Stage ",stage," not sorted on flow ",id);
 		return;
@@ -274,7 +321,7 @@ void RTMFPFlow::onFragment(UInt64 stage,PacketReader& fragment,UInt8 flags) {
 			_numberLostFragments += _pPacket->fragments;
 			delete _pPacket;
 		}
-		_pPacket = new RTMFPPacket(_poolBuffers,fragment);
+		_pPacket = new RTMFPPacket(_poolBuffers,fragment,messageSize);
 		return;
 	}
 
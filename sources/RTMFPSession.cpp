@@ -37,7 +37,7 @@ using namespace std;
 UInt32 RTMFPSession::RTMFPSessionCounter = 0x02000000;
 
 RTMFPSession::RTMFPSession(Invoker* invoker, OnSocketError pOnSocketError, OnStatusEvent pOnStatusEvent, OnMediaEvent pOnMediaEvent) : 
-	_nbCreateStreams(0), _port("1935"), p2pPublishReady(false), p2pPlayReady(false), publishReady(false), connectReady(false), dataAvailable(false), FlowManager(invoker, pOnSocketError, pOnStatusEvent, pOnMediaEvent) {
+	_nbCreateStreams(0), _port("1935"), _audioLifetime(RTMFP_AUDIO_LIFETIME), _keyFrameLifetime(RTMFP_KEYFRAME_LIFETIME), _interFrameLifetime(RTMFP_INTERFRAME_LIFETIME), p2pPublishReady(false), p2pPlayReady(false), publishReady(false), connectReady(false), FlowManager(invoker, pOnSocketError, pOnStatusEvent, pOnMediaEvent) {
 	onStreamCreated = [this](UInt16 idStream) {
 		return handleStreamCreated(idStream);
 	};
@@ -89,9 +89,11 @@ RTMFPSession::RTMFPSession(Invoker* invoker, OnSocketError pOnSocketError, OnSta
 		auto itPeer = _mapPeersById.lower_bound(peerId);
 
 		// If the peer session doesn't exists we create it
-		if (itPeer == _mapPeersById.end() || itPeer->first != peerId)
+		if (itPeer == _mapPeersById.end() || itPeer->first != peerId) {
 			itPeer = _mapPeersById.emplace_hint(itPeer, piecewise_construct, forward_as_tuple(peerId),
 				forward_as_tuple(new P2PSession(this, peerId, _pInvoker, _pOnSocketError, _pOnStatusEvent, _pOnMedia, _pConnection->address(), true, (bool)_group)));
+			itPeer->second->setAckPolicy(_ackDelay, _ackPackets);
+		}
 		itPeer->second->subscribe(pConn);
 		
 		if (itPeer->second->status > RTMFP::HANDSHAKE38) {
@@ -198,8 +200,11 @@ RTMFPSession::RTMFPSession(Invoker* invoker, OnSocketError pOnSocketError, OnSta
 RTMFPSession::~RTMFPSession() {
 	lock_guard<std::mutex> lock(_mutexConnections);
 
-	// Close the connections
-	close(true);
+	// Close the connections (their writers can be flushed by the reception until the handler is closed)
+	{
+		lock_guard<std::recursive_mutex> lockHandler(_pSocketHandler->mutex());
+		close(true);
+	}
 
 	// Close the handler to wait the end of current reception (avoid crashes)
 	_pSocketHandler->close();
@@ -279,12 +284,18 @@ void RTMFPSession::handleNewWriter(shared_ptr<RTMFPWriter>& pWriter) {
 		_pMainWriter = pWriter;
 }
 
-bool RTMFPSession::connect(Exception& ex, const char* url, const char* host) {
+bool RTMFPSession::connect(Exception& ex, const char* url, const char* host, bool batchedIO) {
 	if (!_pInvoker) {
 		ex.set(Exception::APPLICATION, "Invoker is not initialized");
 		return false;
 	}
 
+	if (batchedIO) {
+		Exception exBatch;
+		if (!_pSocketHandler->enableBatchedIO(exBatch))
+			WARN("Unable to enable batched IO (", exBatch.error(), "), the default socket will be used")
+	}
+
 	_url = url;
 	RTMFP::Write7BitValue(_rawUrl, strlen(url) + 1);
 	String::Append(_rawUrl, '\x0A', url);
@@ -341,6 +352,7 @@ void RTMFPSession::connect2Peer(const string& peerId, const char* streamName, co
 		forward_as_tuple(new P2PSession(this, peerId, _pInvoker, _pOnSocketError, _pOnStatusEvent, _pOnMedia, hostAddress, false, (bool)_group)));
 
 	shared_ptr<P2PSession> pPeer = itPeer->second;
+	pPeer->setAckPolicy(_ackDelay, _ackPackets);
 	// P2P unicast : add command play to send when connected
 	if (streamName) 
 		pPeer->addCommand(NETSTREAM_PLAY, streamName);
@@ -408,7 +420,10 @@ void RTMFPSession::connect2Group(const char* streamName, RTMFPGroupConfig* param
 }
 
 bool RTMFPSession::read(const char* peerId, UInt8* buf, UInt32 size, int& nbRead) {
-	
+
+	// Reset the signal before reading, a packet received after the reading will wake up the reader
+	readSignal.reset();
+
 	bool res(true);
 	auto itPeer = _mapPeersById.find(peerId);
 	if (itPeer != _mapPeersById.end() && (!(res = itPeer->second->readAsync(buf, size, nbRead)) || nbRead > 0))
@@ -419,10 +434,32 @@ bool RTMFPSession::read(const char* peerId, UInt8* buf, UInt32 size, int& nbRead
 	return true;
 }
 
+bool RTMFPSession::readFrames(const char* peerId, RTMFPFrame* frames, UInt32 count, int& nbFrames) {
+	releaseFrames(peerId); // the frames of the previous call are released
+
+	// Reset the signal before reading, a packet received after the reading will wake up the reader
+	readSignal.reset();
+
+	bool res(true);
+	auto itPeer = _mapPeersById.find(peerId);
+	if (itPeer != _mapPeersById.end() && (!(res = itPeer->second->readFrames(frames, count, nbFrames)) || nbFrames > 0))
+		return res; // quit if treated
+
+	return FlowManager::readFrames(frames, count, nbFrames);
+}
+
+void RTMFPSession::releaseFrames(const char* peerId) {
+	auto itPeer = _mapPeersById.find(peerId);
+	if (itPeer != _mapPeersById.end())
+		itPeer->second->releaseFrames();
+	FlowManager::releaseFrames();
+}
+
 void RTMFPSession::handleDataAvailable(bool isAvailable) {
-	dataAvailable = isAvailable; 
-	if (dataAvailable)
+	if (isAvailable)
 		readSignal.set(); // notify the client that data is available
+	else
+		readSignal.reset();
 }
 
 bool RTMFPSession::write(const UInt8* buf, UInt32 size, int& pos) {
@@ -440,7 +477,32 @@ bool RTMFPSession::write(const UInt8* buf, UInt32 size, int& pos) {
 	return _pPublisher->publish(buf, size, pos);
 }
 
+bool RTMFPSession::writeFrames(const RTMFPFrame* frames, UInt32 count, int& queued) {
+	queued = 0;
+	if (status == RTMFP::FAILED)
+		return false; // to stop the parent loop
+
+	if (!_pPublisher || !_pPublisher->count()) {
+		DEBUG("Can't write frames because NetStream is not published")
+		return true;
+	}
+
+	bool done;
+	for (UInt32 i = 0; i < count; ++i) {
+		if (!_pPublisher->publish(frames[i].type, frames[i].time, (const UInt8*)frames[i].data, frames[i].size, done))
+			return queued > 0; // the frames already queued are reported, error only if it is the first one
+		if (!done)
+			break; // the queue is full
+		++queued;
+	}
+	return true;
+}
+
 unsigned int RTMFPSession::callFunction(const char* function, int nbArgs, const char** args, const char* peerId) {
+	// The writers are flushed with the congestion controllers of the connections, shared with the reception and the cycle
+	lock_guard<std::mutex> lock(_mutexConnections);
+	lock_guard<std::recursive_mutex> lockHandler(_pSocketHandler->mutex());
+
 	// Server call
 	if (!peerId && _pMainStream && _pMainWriter) {
 		// TODO: refactorize with P2PSession code
@@ -505,7 +567,8 @@ bool RTMFPSession::handleStreamCreated(UInt16 idStream) {
 		AMFWriter& amfWriter = pWriter->writeInvocation("publish", true);
 		amfWriter.writeString(command.value.c_str(), command.value.size());
 		pWriter->flush();
-		_pPublisher.reset(new Publisher(command.value, *_pInvoker, command.audioReliable, command.videoReliable, false));
+		_pPublisher.reset(new Publisher(command.value, poolBuffers(), command.audioReliable, command.videoReliable, false));
+		_pPublisher->setLifetimes(_audioLifetime, _keyFrameLifetime, _interFrameLifetime);
 		break;
 	}
 	default:
@@ -520,6 +583,8 @@ void RTMFPSession::manage() {
 	if (!_pMainStream)
 		return;
 	lock_guard<std::mutex> lock(_mutexConnections);
+	// The writers are also written and flushed by the reception : the cycle is serialized with it by the lock of the handler
+	unique_lock<std::recursive_mutex> lockHandler(_pSocketHandler->mutex());
 
 	// Release closed P2P connections
 	auto itConnection = _mapPeersById.begin();
@@ -528,14 +593,13 @@ void RTMFPSession::manage() {
 			DEBUG("RTMFPSession management - Deleting closed P2P session to ", itConnection->first)
 			_mapPeersById.erase(itConnection++);
 		}
-		else {
-			itConnection->second->manage();
+		else
 			++itConnection;
-		}
 	}
 
-	// Manage the flows
-	FlowManager::manage();
+	// Push the media written by the application (before the close commands)
+	if (_pPublisher)
+		_pPublisher->drain();
 
 	// Treat waiting commands
 	createWaitingStreams();
@@ -543,12 +607,59 @@ void RTMFPSession::manage() {
 	// Send waiting P2P connections
 	sendConnections();
 
-	if (_pSocketHandler)
-		_pSocketHandler->manage();
+	// Raise the timers due (connections, writers, flows, NetGroup...)
+	_pSocketHandler->manage();
+	lockHandler.unlock();
 
-	// Manage NetGroup
-	if (_group)
-		_group->manage();
+	// Send the packets of this cycle (batched IO mode, the reception is not locked meanwhile)
+	_pSocketHandler->flush();
+}
+
+void RTMFPSession::getStatistics(RTMFPStatistics& statistics) {
+	UInt64 receiveCalls, packetsReceived, sendCalls, packetsSent;
+	_pSocketHandler->ioCounters(receiveCalls, packetsReceived, sendCalls, packetsSent);
+	statistics.receiveCalls = receiveCalls;
+	statistics.packetsReceived = packetsReceived;
+	statistics.sendCalls = sendCalls;
+	statistics.packetsSent = packetsSent;
+
+	if (_pConnection) {
+		CongestionController& congestion = _pConnection->congestion();
+		statistics.congestionWindow = congestion.window();
+		statistics.bytesInFlight = congestion.bytesInFlight();
+		statistics.pacingRate = congestion.pacingRate();
+		const RTTEstimator& rtt = _pConnection->rtt();
+		statistics.rtt = rtt.srtt();
+		statistics.rttVariation = rtt.rttvar();
+		statistics.rto = rtt.rto();
+	}
+
+	statistics.acksSaved = acksSaved();
+	statistics.reorderBytes = reorderBytes();
+	statistics.reorderDepth = reorderDepth();
+	statistics.expiredBytes = expiredBytes();
+	statistics.droppedFrames = droppedFrames();
+	UInt64 poolAllocations, poolHits;
+	UInt32 poolPeak;
+	ObjectPools::Read(poolAllocations, poolHits, poolPeak);
+	statistics.poolAllocations = poolAllocations;
+	statistics.poolHits = poolHits;
+	statistics.poolPeak = poolPeak;
+	UInt64 packets(FlowManager::packetsSent()), bytes(bytesSent()), deferred(flushesDeferred());
+	lock_guard<std::mutex> lock(_mutexConnections);
+	for (auto& itPeer : _mapPeersById) {
+		statistics.acksSaved += itPeer.second->acksSaved();
+		statistics.expiredBytes += itPeer.second->expiredBytes();
+		statistics.droppedFrames += itPeer.second->droppedFrames();
+		statistics.reorderBytes += itPeer.second->reorderBytes();
+		if (itPeer.second->reorderDepth() > statistics.reorderDepth)
+			statistics.reorderDepth = itPeer.second->reorderDepth();
+		packets += itPeer.second->packetsSent();
+		bytes += itPeer.second->bytesSent();
+		deferred += itPeer.second->flushesDeferred();
+	}
+	statistics.packetFill = packets ? (unsigned int)(bytes * 100 / (packets * RTMFP_MAX_PACKET_SIZE)) : 0;
+	statistics.packetFillUnpacked = packets ? (unsigned int)(bytes * 100 / ((packets + deferred) * RTMFP_MAX_PACKET_SIZE)) : 0;
 }
 
 // TODO: see if we always need to manage a list of commands
@@ -569,6 +680,8 @@ void RTMFPSession::createWaitingStreams() {
 	while(itCommand != _waitingCommands.end()) {
 		
 		if(itCommand->type == NETSTREAM_CLOSE) {
+			if (_pPublisher)
+				_pPublisher->drain(true); // the end of the stream is pushed even to the congested listeners before to stop
 			INFO("Unpublishing stream ", itCommand->value, "...")
 			if(!_pPublisher)
 				ERROR("Unable to find the publisher")
@@ -587,8 +700,10 @@ void RTMFPSession::createWaitingStreams() {
 			INFO("Creating publisher for stream ", itCommand->value, "...")
 			if (_pPublisher)
 				ERROR("A publisher already exists (name : ", _pPublisher->name(), "), command ignored")
-			else
-				_pPublisher.reset(new Publisher(itCommand->value, *_pInvoker, itCommand->audioReliable, itCommand->videoReliable, true));
+			else {
+				_pPublisher.reset(new Publisher(itCommand->value, poolBuffers(), itCommand->audioReliable, itCommand->videoReliable, true));
+				_pPublisher->setLifetimes(_audioLifetime, _keyFrameLifetime, _interFrameLifetime);
+			}
 			_waitingCommands.erase(itCommand++);
 		}
 		else
@@ -622,7 +737,7 @@ void RTMFPSession::onConnect() {
 
 	// Record port for setPeerInfo request
 	if (_pMainStream && _pMainWriter) {
-		UInt16 port = _pSocketHandler->socket().address().port();
+		UInt16 port = _pSocketHandler->port();
 		INFO("Sending peer info (port : ", port, ")")
 		AMFWriter& amfWriter = _pMainWriter->writeInvocation("setPeerInfo");
 
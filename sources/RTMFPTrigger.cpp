@@ -19,45 +19,45 @@ You should have received a copy of the GNU Lesser General Public License
 along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+
 #include "RTMFPTrigger.h"
 
 using namespace std;
 using namespace Mona;
 
-RTMFPTrigger::RTMFPTrigger(UInt32 delay, Mona::UInt8 cycles) : _time(1),_cycle(0),_running(false), _delay(delay), _cycles(cycles) {
+RTMFPTrigger::RTMFPTrigger(UInt8 maxBackoff) : _time(0), _backoff(0), _running(false), _maxBackoff(maxBackoff) {
 	
 }
 
-void RTMFPTrigger::reset() {
-	_timeElapsed.update();
-	_time=1;
-	_cycle=0;
+void RTMFPTrigger::reset(Int64 now) {
+	_time = now;
+	_backoff=0;
 }
 
-void RTMFPTrigger::start() {
+void RTMFPTrigger::start(Int64 now) {
 	if(_running)
 		return;
-	reset();
+	reset(now);
 	_running=true;
 }
 
-UInt16 RTMFPTrigger::raise(Exception& ex) {
+UInt32 RTMFPTrigger::timeout(UInt32 rto) const {
+	UInt64 timeout = ((UInt64)rto) << _backoff;
+	return (timeout > RTMFP_RTO_MAX) ? RTMFP_RTO_MAX : (UInt32)timeout;
+}
+
+bool RTMFPTrigger::raise(Exception& ex, UInt32 rto, Int64 now) {
 	if(!_running)
-		return 0;
-	// Wait at least _delay sec before to begin the repeat cycle
-	if(!_timeElapsed.isElapsed(_delay))
-		return 0;
-	++_time;
-	_timeElapsed.update();
-	if(_time>=_cycle) {
-		_time=1;
-		++_cycle;
-		if (_cycle == _cycles) {
-			ex.set(Exception::PROTOCOL, "Repeat RTMFPTrigger failed");
-			return 0;
-		}
-		return _cycle;
+		return false;
+
+	if(now - _time <= timeout(rto))
+		return false;
+
+	if (_backoff == _maxBackoff) {
+		ex.set(Exception::PROTOCOL, "Repeat RTMFPTrigger failed");
+		return false;
 	}
-	return 0;
+	++_backoff;
+	_time = now;
+	return true;
 }
-
@@ -29,7 +29,7 @@ using namespace std;
 using namespace Mona;
 
 RTMFPWriter::RTMFPWriter(State state,const string& signature, BandWriter& band, shared_ptr<RTMFPWriter>& pThis, UInt64 idFlow) : FlashWriter(state,band.poolBuffers()), id(0), _band(band),
-	_stage(0), _stageAck(0), flowId(idFlow), signature(signature), _repeatable(0), _lostCount(0), _ackCount(0) {
+	_stage(0), _stageAck(0), flowId(idFlow), signature(signature), priority(WriterScheduler::CONTROL), _repeatable(0), _lostCount(0), _ackCount(0), _closeTime(0) {
 
 	pThis.reset(this);
 	_band.initWriter(pThis);
@@ -38,7 +38,7 @@ RTMFPWriter::RTMFPWriter(State state,const string& signature, BandWriter& band,
 }
 
 RTMFPWriter::RTMFPWriter(State state,const string& signature, BandWriter& band, UInt64 idFlow) : FlashWriter(state,band.poolBuffers()), id(0), _band(band),
-	_stage(0), _stageAck(0), flowId(idFlow), signature(signature), _repeatable(0), _lostCount(0), _ackCount(0) {
+	_stage(0), _stageAck(0), flowId(idFlow), signature(signature), priority(WriterScheduler::CONTROL), _repeatable(0), _lostCount(0), _ackCount(0), _closeTime(0) {
 
 	shared_ptr<RTMFPWriter> pThis(this);
 	_band.initWriter(pThis);
@@ -48,7 +48,7 @@ RTMFPWriter::RTMFPWriter(State state,const string& signature, BandWriter& band,
 
 RTMFPWriter::RTMFPWriter(RTMFPWriter& writer) : FlashWriter(writer), _band(writer._band),
 	_repeatable(writer._repeatable), _stage(writer._stage), _stageAck(writer._stageAck),
-	_ackCount(writer._ackCount), _lostCount(writer._lostCount), flowId(writer.flowId), signature(writer.signature), id(writer.id) {
+	_ackCount(writer._ackCount), _lostCount(writer._lostCount), flowId(writer.flowId), signature(writer.signature), priority(writer.priority), id(writer.id), _closeTime(0) {
 	reliable = true;
 	close();
 }
@@ -64,25 +64,35 @@ void RTMFPWriter::abort() {
 	RTMFPMessage* pMessage;
 	while(!_messages.empty()) {
 		pMessage = _messages.front();
-		_lostCount += pMessage->fragments.size();
 		delete pMessage;
 		_messages.pop_front();
 	}
-	while(!_messagesSent.empty()) {
-		pMessage = _messagesSent.front();
-		_lostCount += pMessage->fragments.size();
-		if(pMessage->repeatable)
-			--_repeatable;
-		delete pMessage;
-		_messagesSent.pop_front();
+	while(!_fragments.empty()) {
+		++_lostCount;
+		_band.congestion().onDataAbandoned(_fragments.front().size); // no more in flight
+		popFragment();
 	}
 	if(_stage>0) {
 		createMessage(); // Send a MESSAGE_ABANDONMENT just in the case where the receiver has been created
-		flush(false);
+		flush(false, false);
 		_trigger.stop();
 	}
 }
 
+bool RTMFPWriter::popFragment() {
+	RetransmissionQueue::Fragment& fragment(_fragments.front());
+	RTMFPMessage* pMessage = fragment.pMessage;
+	bool last = (fragment.offset + fragment.size) >= pMessage->size();
+	_fragments.pop();
+	if (!last)
+		return false;
+
+	if(pMessage->repeatable)
+		--_repeatable;
+	delete pMessage;
+	return true;
+}
+
 void RTMFPWriter::clear() {
 
 	for (RTMFPMessage* pMessage : _messages)
@@ -97,7 +107,8 @@ void RTMFPWriter::close(Int32 code) {
 	if(_stage>0 || _messages.size()>0)
 		createMessage(); // Send a MESSAGE_END just in the case where the receiver has been created (or will be created)
 	FlashWriter::close(code); 
-	_closeTime.update();
+	_closeTime = _band.timers().now();
+	schedule();
 }
 
 bool RTMFPWriter::acknowledgment(Exception& ex, PacketReader& packet) {
@@ -114,7 +125,6 @@ bool RTMFPWriter::acknowledgment(Exception& ex, PacketReader& packet) {
 
 	UInt64 stageAckPrec = _stageAck;
 	UInt64 stageReaden = packet.read7BitLongValue();
-	UInt64 stage = _stageAck+1;
 
 	if(stageReaden>_stage) {
 		ERROR("Acknowledgment received ",stageReaden," superior than the current sending stage ",_stage," on writer ",id);
@@ -136,118 +146,76 @@ bool RTMFPWriter::acknowledgment(Exception& ex, PacketReader& packet) {
 		packet.reset(pos);
 	}
 
-	UInt64 lostCount = 0;
-	UInt64 lostStage = 0;
+	bool lost = false;
 	bool repeated = false;
 	bool header = true;
-	bool stop=false;
-
-	auto it=_messagesSent.begin();
-	while(!stop && it!=_messagesSent.end()) {
-		RTMFPMessage& message(**it);
-
-		if(message.fragments.empty()) {
-			CRITIC("RTMFPMessage ",(stage+1)," is bad formatted on flowWriter ",id);
-			++it;
-			continue;
+	bool error = false;
+	UInt64 lastStage = 0; // last stage written (to know if the header is needed)
+	Int64 now = _band.timers().now();
+
+	// Read lost informations : lostCount stages lost from lostStage, then stages received until stageReaden
+	while(packet.available()>0) {
+		UInt64 lostStage = stageReaden+1;
+		UInt64 lostCount = packet.read7BitLongValue()+1;
+		stageReaden = lostStage+lostCount+packet.read7BitLongValue();
+
+		// check the range
+		if(lostStage>_stage) {
+			// Not yet sent
+			ERROR("Lost information received ",lostStage," have not been yet sent on writer ",id);
+			error = true;
+			break;
+		}
+		// No repeated, it means that past lost packets were not repeatable, we can ack the intermediate received sequence
+		if(!repeated && lostStage>_stageAck+1)
+			_stageAck = lostStage-1;
+
+		UInt64 lastLost = lostStage+lostCount-1;
+		if(lastLost>_stage) {
+			ERROR("Some lost information received have not been yet sent on writer ",id);
+			lastLost = _stage;
+			error = true;
 		}
 
-		map<UInt32,UInt64>::iterator itFrag=message.fragments.begin();
-		while(message.fragments.end()!=itFrag) {
-			
-			// ACK
-			if(_stageAck>=stage) {
-				message.fragments.erase(message.fragments.begin());
-				itFrag=message.fragments.begin();
-				++_ackCount;
-				++stage;
-				continue;
-			}
-
-			// Read lost informations
-			while(!stop) {
-				if(lostCount==0) {
-					if(packet.available()>0) {
-						lostCount = packet.read7BitLongValue()+1;
-						lostStage = stageReaden+1;
-						stageReaden = lostStage+lostCount+packet.read7BitLongValue();
-					} else {
-						stop=true;
-						break;
-					}
-				}
-				// check the range
-				if(lostStage>_stage) {
-					// Not yet sent
-					ERROR("Lost information received ",lostStage," have not been yet sent on writer ",id);
-					stop=true;
-				} else if(lostStage<=_stageAck) {
-					// already acked
-					--lostCount;
-					++lostStage;
-					continue;
-				}
-				break;
-			}
-			if(stop)
-				break;
-			
-			// lostStage > 0 and lostCount > 0
-
-			if(lostStage!=stage) {
-				if(repeated) {
-					++stage;
-					++itFrag;
-					header=true;
-				} else // No repeated, it means that past lost packet was not repeatable, we can ack this intermediate received sequence
-					_stageAck = stage;
-				continue;
-			}
+		for(UInt64 stage = (lostStage>_stageAck) ? lostStage : _stageAck+1; stage<=lastLost; ++stage) {
+			if(!_fragments.has(stage))
+				continue; // already acked
 
 			/// Repeat message asked!
+			RetransmissionQueue::Fragment& fragment(_fragments[stage]);
+			RTMFPMessage& message(*fragment.pMessage);
 			if(!message.repeatable) {
-				if(repeated) {
-					++itFrag;
-					++stage;
-					header=true;
-				} else {
+				if(!repeated) {
 					INFO("RTMFPWriter ",id," : message ",stage," lost");
+					lost = true;
 					--_ackCount;
 					++_lostCount;
 					_stageAck = stage;
 				}
-				--lostCount;
-				++lostStage;
 				continue;
 			}
 
 			repeated = true;
-			// Don't repeat before that the receiver receives the itFrag->second sending stage
-			if(itFrag->second >= maxStageRecv) {
-				++stage;
-				header=true;
-				--lostCount;
-				++lostStage;
-				++itFrag;
+			// Don't repeat before that the receiver receives the fragment.sentStage sending stage
+			if(fragment.sentStage >= maxStageRecv)
 				continue;
-			}
 
 			// Repeat message
 
 			DEBUG("RTMFPWriter ",id," : stage ",stage," repeated");
-			UInt32 fragment(itFrag->first);
-			itFrag->second = _stage; // Save actual stage sending to wait that the receiver gets it before to retry
-			UInt32 contentSize = message.size() - fragment; // available
-			++itFrag;
+			lost = true;
+			fragment.sentStage = _stage; // Save actual stage sending to wait that the receiver gets it before to retry
+			UInt32 contentSize = repeatSize(fragment, now);
 
 			// Compute flags
 			UInt8 flags = 0;
-			if(fragment>0)
+			if(contentSize && fragment.offset>0)
 				flags |= MESSAGE_WITH_BEFOREPART; // fragmented
-			if(itFrag!=message.fragments.end()) {
+			if(contentSize && fragment.offset+fragment.size<message.size())
 				flags |= MESSAGE_WITH_AFTERPART;
-				contentSize = itFrag->first - fragment;
-			}
+
+			if(stage!=lastStage+1)
+				header=true; // not following the last stage written
 
 			UInt32 size = contentSize+4;
 			UInt32 availableToWrite(_band.availableToWrite());
@@ -264,46 +232,48 @@ bool RTMFPWriter::acknowledgment(Exception& ex, PacketReader& packet) {
 
 			// Write packet
 			size-=3;  // type + timestamp removed, before the "writeMessage"
-			packMessage(_band.writeMessage(header ? 0x10 : 0x11,(UInt16)size),stage,flags,header,message,fragment,contentSize);
+			packMessage(_band.writeMessage(header ? 0x10 : 0x11,(UInt16)size),stage,flags,header,message,fragment.offset,contentSize);
 			header=false;
-			--lostCount;
-			++lostStage;
-			++stage;
+			lastStage = stage;
+		}
+		if(error)
+			break;
+	}
+	// No repeated, the stages received after the last lost range are acknowledged too
+	if(!error && !repeated && stageReaden>_stageAck)
+		_stageAck = (stageReaden>_stage) ? _stage : stageReaden;
+
+	// ACK : remove the fragments acknowledged (and their messages)
+	while(!_fragments.empty() && _fragments.firstStage()<=_stageAck) {
+		_band.congestion().onDataAcknowledged(_fragments.front().size);
+		++_ackCount;
+		if(popFragment() && (_ackCount || _lostCount)) {
+			//TODO : _qos.add(_lostCount / (_lostCount + _ackCount));
+			_ackCount=_lostCount=0;
 		}
-
-		if(message.fragments.empty()) {
-			if(message.repeatable)
-				--_repeatable;
-			if(_ackCount || _lostCount) {
-				//TODO : _qos.add(_lostCount / (_lostCount + _ackCount));
-				_ackCount=_lostCount=0;
-			}
-			
-			delete *it;
-			it=_messagesSent.erase(it);
-		} else
-			++it;
-	
 	}
 
-	if(lostCount>0 && packet.available()>0)
-		ERROR("Some lost information received have not been yet sent on writer ",id);
-
+	if (lost)
+		_band.congestion().onLoss();
 
 	// rest messages repeatable?
 	if(_repeatable==0)
 		_trigger.stop();
-	else if(_stageAck>stageAckPrec || repeated)
-		_trigger.reset();
+	else if(_stageAck>stageAckPrec)
+		_trigger.reset(now);
+	else if(repeated) // fast retransmit, wait a new timeout before sending back the messages
+		_trigger.restart(now);
+	schedule();
 	return true;
 }
 
 void RTMFPWriter::manage(Exception& ex) {
 	if(!consumed() && !_band.failed()) {
 		
-		// if some acknowlegment has not been received we send the messages back (8 times, with progressive occurences)
-		if (_trigger.raise(ex)) {
-			TRACE("Sending back repeatable messages (cycle : ", _trigger.cycle(), ")")
+		// if some acknowlegment has not been received we send the messages back (after the retransmission timeout, doubled each time)
+		if (_trigger.raise(ex, _band.rtt().rto(), _band.timers().now())) {
+			TRACE("Sending back repeatable messages (backoff : ", _trigger.backoff(), ")")
+			_band.congestion().onTimeout();
 			raiseMessage();
 		}
 		// When the peer/server doesn't send acknowledgment since a while we close the writer
@@ -317,7 +287,24 @@ void RTMFPWriter::manage(Exception& ex) {
 		ex.set(Exception::NETWORK, "Main flow writer closed, session is closing");
 		return;
 	}*/
-	flush();
+	// new messages are sent by the scheduler of the connection
+	schedule();
+}
+
+void RTMFPWriter::schedule() {
+	TimerWheel& timers(_band.timers());
+	Int64 deadline;
+	if (_trigger.running() && !_band.failed())
+		deadline = _trigger.deadline(_band.rtt().rto());
+	else if (state() == CLOSED)
+		deadline = _closeTime + 130001; // see consumed()
+	else {
+		timers.cancel(timer);
+		return;
+	}
+	if (deadline <= timers.now())
+		deadline = timers.now() + 1; // not before the next cycle
+	timers.set(timer, deadline);
 }
 
 UInt32 RTMFPWriter::headerSize(UInt64 stage) { // max size header = 50
@@ -382,17 +369,14 @@ void RTMFPWriter::raiseMessage() {
 	bool header = true;
 	bool stop = true;
 	bool sent = false;
-	UInt64 stage = _stageAck+1;
+	Int64 now = _band.timers().now();
 
-	for(RTMFPMessage* pMessage : _messagesSent) {
-		RTMFPMessage& message(*pMessage);
-		
-		if(message.fragments.empty())
-			break;
+	for(UInt64 stage = _fragments.firstStage(); !_fragments.empty() && stage<=_fragments.lastStage(); ++stage) {
+		RetransmissionQueue::Fragment& fragment(_fragments[stage]);
+		RTMFPMessage& message(*fragment.pMessage);
 
 		// not repeat unbuffered messages
 		if(!message.repeatable) {
-			stage += message.fragments.size();
 			header = true;
 			continue;
 		}
@@ -404,53 +388,53 @@ void RTMFPWriter::raiseMessage() {
 			stop = false;
 		}
 
-		map<UInt32,UInt64>::const_iterator itFrag=message.fragments.begin();
-		UInt32 available = message.size()-itFrag->first;
-	
-		while(itFrag!=message.fragments.end()) {
-			UInt32 contentSize = available;
-			UInt32 fragment(itFrag->first);
-			++itFrag;
+		UInt32 contentSize = repeatSize(fragment, now);
 
-			// Compute flags
-			UInt8 flags = 0;
-			if(fragment>0)
-				flags |= MESSAGE_WITH_BEFOREPART; // fragmented
-			if(itFrag!=message.fragments.end()) {
-				flags |= MESSAGE_WITH_AFTERPART;
-				contentSize = itFrag->first - fragment;
-			}
+		// Compute flags
+		UInt8 flags = 0;
+		if(contentSize && fragment.offset>0)
+			flags |= MESSAGE_WITH_BEFOREPART; // fragmented
+		if(contentSize && fragment.offset+fragment.size<message.size())
+			flags |= MESSAGE_WITH_AFTERPART;
 
-			UInt32 size = contentSize+4;
+		UInt32 size = contentSize+4;
 
-			if(header)
-				size+=headerSize(stage);
-
-			// Actual sending packet is enough large? Here we send just one packet!
-			if(size>_band.availableToWrite()) {
-				if(!sent)
-					ERROR("Raise messages on writer ",id," without sending!");
-				DEBUG("Raise message on writer ",id," finishs on stage ",stage);
-				return;
-			}
-			sent=true;
+		if(header)
+			size+=headerSize(stage);
 
-			// Write packet
-			size-=3;  // type + timestamp removed, before the "writeMessage"
-			packMessage(_band.writeMessage(header ? 0x10 : 0x11,(UInt16)size),stage++,flags,header,message,fragment,contentSize);
-			available -= contentSize;
-			header=false;
+		// Actual sending packet is enough large? Here we send just one packet!
+		if(size>_band.availableToWrite()) {
+			if(!sent)
+				ERROR("Raise messages on writer ",id," without sending!");
+			DEBUG("Raise message on writer ",id," finishs on stage ",stage);
+			return;
 		}
+		sent=true;
+
+		// Write packet
+		size-=3;  // type + timestamp removed, before the "writeMessage"
+		packMessage(_band.writeMessage(header ? 0x10 : 0x11,(UInt16)size),stage,flags,header,message,fragment.offset,contentSize);
+		header=false;
 	}
 
 	if(stop)
 		_trigger.stop();
 }
 
-bool RTMFPWriter::flush(bool full) {
+UInt32 RTMFPWriter::repeatSize(RetransmissionQueue::Fragment& fragment, Int64 now) {
+	if(!fragment.abandoned) {
+		if(!fragment.pMessage->expired(now))
+			return fragment.size;
+		fragment.abandoned = true;
+		_band.onExpired(fragment.size);
+	}
+	return 0;
+}
+
+bool RTMFPWriter::flush(bool full, bool paced) {
 
-	if(_messagesSent.size()>100)
-		TRACE("Buffering become high : _messagesSent.size()=",_messagesSent.size());
+	if(_fragments.count()>1000)
+		TRACE("Buffering become high : ",_fragments.count()," fragments waiting for acknowledgment");
 
 	if(state()==OPENING) {
 		ERROR("Violation policy, impossible to flush data on a opening writer");
@@ -458,76 +442,115 @@ bool RTMFPWriter::flush(bool full) {
 	}
 
 	bool hasSent(false);
+	UInt8 priority;
+	while((priority = nextPriority()) < WriterScheduler::COUNT) {
+		// Wait for the acknowledgments, the pacing tokens or the messages of higher classes (the next messages will be sent by the scheduler)
+		if (paced && !_band.canSend(priority))
+			break;
+		hasSent = true;
+		sendMessage();
+	}
 
-	// flush
-	bool header = !_band.canWriteFollowing(*this);
+	// The packet is sent at the end of the cycle, it can be completed by the next messages of the writers
+	if (full)
+		_band.flushLater();
+	return hasSent;
+}
 
-	while(!_messages.empty()) {
-		hasSent = true;
+UInt8 RTMFPWriter::nextPriority() {
+	if(state()==OPENING)
+		return WriterScheduler::COUNT;
 
+	Int64 now = _band.timers().now();
+	while(!_messages.empty()) {
 		RTMFPMessage& message(*_messages.front());
+		// Message expired while waiting for the congestion window, it is not sent at all
+		if(!message.expired(now) || (_messages.size()==1 && state()==CLOSED))
+			return message.priority;
+		DEBUG("RTMFPWriter ",id," : media message of ",message.size()," bytes expired before sending")
+		_band.onExpired(message.size());
+		delete &message;
+		_messages.pop_front();
+	}
+	return WriterScheduler::COUNT;
+}
 
-		if(message.repeatable) {
-			++_repeatable;
-			_trigger.start();
+UInt32 RTMFPWriter::packedSize() {
+	if (_messages.empty())
+		return 0;
+	UInt32 size(_messages.front()->size() + 4), minSize(12); // 12 to have a size minimum of fragmentation (see sendMessage)
+	if (!_band.canWriteFollowing(*this)) {
+		UInt32 headerSize(this->headerSize(_stage + 1));
+		size += headerSize;
+		minSize += headerSize;
+	}
+	return size < minSize ? minSize : size;
+}
+
+UInt32 RTMFPWriter::sendMessage() {
+	RTMFPMessage& message(*_messages.front());
+	bool header = !_band.canWriteFollowing(*this);
+
+	if(message.repeatable) {
+		++_repeatable;
+		if(!_trigger.running()) {
+			_trigger.start(_band.timers().now());
+			schedule();
 		}
+	}
 
-		UInt32 fragments= 0;
-		UInt32 available = message.size();
-	
-		do {
+	UInt32 fragments= 0;
+	UInt32 available = message.size();
 
-			++_stage;
+	do {
 
-			// Actual sending packet is enough large?
-			UInt32 contentSize = _band.availableToWrite();
-			UInt32 headerSize = (header && contentSize<62) ? this->headerSize(_stage) : 0; // calculate only if need!
-			if(contentSize<(headerSize+12)) { // 12 to have a size minimum of fragmentation
-				_band.flush(); // send packet (and without time echo)
-				header=true;
-			}
+		++_stage;
 
-			contentSize = available;
-			UInt32 size = contentSize+4;
-			
-			if(header)
-				size+= headerSize>0 ? headerSize : this->headerSize(_stage);
+		// Actual sending packet is enough large?
+		UInt32 contentSize = _band.availableToWrite();
+		UInt32 headerSize = (header && contentSize<62) ? this->headerSize(_stage) : 0; // calculate only if need!
+		if(contentSize<(headerSize+12)) { // 12 to have a size minimum of fragmentation
+			_band.flush(); // send packet (and without time echo)
+			header=true;
+		}
 
-			// Compute flags
-			UInt8 flags = 0;
-			if(fragments>0)
-				flags |= MESSAGE_WITH_BEFOREPART;
+		contentSize = available;
+		UInt32 size = contentSize+4;
+		
+		if(header)
+			size+= headerSize>0 ? headerSize : this->headerSize(_stage);
+
+		// Compute flags
+		UInt8 flags = 0;
+		if(fragments>0)
+			flags |= MESSAGE_WITH_BEFOREPART;
+
+		bool head = header;
+		UInt32 availableToWrite(_band.availableToWrite());
+		if(size>availableToWrite) {
+			// the packet will change! The message will be fragmented.
+			flags |= MESSAGE_WITH_AFTERPART;
+			contentSize = availableToWrite-(size-contentSize);
+			size=availableToWrite;
+			header=true;
+		} else
+			header=false; // the packet stays the same!
 
-			bool head = header;
-			UInt32 availableToWrite(_band.availableToWrite());
-			if(size>availableToWrite) {
-				// the packet will change! The message will be fragmented.
-				flags |= MESSAGE_WITH_AFTERPART;
-				contentSize = availableToWrite-(size-contentSize);
-				size=availableToWrite;
-				header=true;
-			} else
-				header=false; // the packet stays the same!
+		// Write packet
+		size-=3; // type + timestamp removed, before the "writeMessage"
+		packMessage(_band.writeMessage(head ? 0x10 : 0x11,(UInt16)size,this),_stage,flags,head,message,fragments,contentSize);
+		//DEBUG("RTMFPWriter ", id, " : sending message ", _stage);
+		
+		_fragments.add(_stage, &message, fragments, contentSize);
+		_band.congestion().onDataSent(contentSize);
+		available -= contentSize;
+		fragments += contentSize;
 
-			// Write packet
-			size-=3; // type + timestamp removed, before the "writeMessage"
-			packMessage(_band.writeMessage(head ? 0x10 : 0x11,(UInt16)size,this),_stage,flags,head,message,fragments,contentSize);
-			//DEBUG("RTMFPWriter ", id, " : sending message ", _stage);
-			
-			message.fragments[fragments] = _stage;
-			available -= contentSize;
-			fragments += contentSize;
-
-		} while(available>0);
-
-		//TODO : _qos.add(message.size(),_band.ping());
-		_messagesSent.emplace_back(&message);
-		_messages.pop_front();
-	}
+	} while(available>0);
 
-	if (full)
-		_band.flush();
-	return hasSent;
+	//TODO : _qos.add(message.size(),_band.ping());
+	_messages.pop_front();
+	return fragments;
 }
 
 RTMFPMessageBuffered& RTMFPWriter::createMessage() {
@@ -536,19 +559,29 @@ RTMFPMessageBuffered& RTMFPWriter::createMessage() {
 		return MessageNull;
 	}
 	RTMFPMessageBuffered* pMessage = new RTMFPMessageBuffered(_band.poolBuffers(),reliable);
+	pMessage->priority = priority;
 	_messages.emplace_back(pMessage);
+	_band.wakeUp(); // sent by the scheduler of the connection at the next cycle
 	return *pMessage;
 }
 
 AMFWriter& RTMFPWriter::write(AMF::ContentType type,UInt32 time,const UInt8* data, UInt32 size) {
 	if (type < AMF::AUDIO || type > AMF::VIDEO)
 		time = 0; // Because it can "dropped" the packet otherwise (like if the Writer was not reliable!)
-	if(data && !reliable && state()==OPENED && !_band.failed()) {
+	// Unbuffered data must be sent now, if messages are waiting for the congestion window we copy it
+	if(data && !reliable && _messages.empty() && state()==OPENED && !_band.failed()) {
 		_messages.emplace_back(new RTMFPMessageUnbuffered(type,time,data,size));
-		flush(false);
+		flush(false, false);
+		_band.wakeUp(); // the packet is sent at the next cycle
         return AMFWriter::Null;
 	}
-	AMFWriter& amf = createMessage().writer();
+	RTMFPMessageBuffered& message(createMessage());
+	if(message && (type == AMF::AUDIO || type == AMF::VIDEO)) {
+		if(lifetime)
+			message.deadline = _band.timers().now() + lifetime;
+		message.priority = (type == AMF::AUDIO) ? WriterScheduler::AUDIO : (RTMFP::IsKeyFrame(data, size) ? WriterScheduler::KEYFRAME : WriterScheduler::INTERFRAME);
+	}
+	AMFWriter& amf = message.writer();
 	BinaryWriter& binary(amf.packet);
 	binary.write8(type);
 	if (type == AMF::INVOCATION_AMF3) // Added for Play request in P2P, TODO: see if it is really needed
@@ -561,6 +594,22 @@ AMFWriter& RTMFPWriter::write(AMF::ContentType type,UInt32 time,const UInt8* dat
 	return amf;
 }
 
+bool RTMFPWriter::writeSharedMedia(MediaType type, UInt32 time, const shared_ptr<const Buffer>& pPayload) {
+	// Unbuffered data is not copied, the payload doesn't need to be kept
+	if ((type != AUDIO && type != VIDEO) || (!reliable && _messages.empty() && state() == OPENED && !_band.failed()))
+		return FlashWriter::writeSharedMedia(type, time, pPayload);
+	if (state() == CLOSED || _band.failed())
+		return true;
+
+	RTMFPMessageShared* pMessage = new RTMFPMessageShared((type == AUDIO) ? AMF::AUDIO : AMF::VIDEO, time, pPayload, reliable);
+	if (lifetime)
+		pMessage->deadline = _band.timers().now() + lifetime;
+	pMessage->priority = (type == AUDIO) ? WriterScheduler::AUDIO : (RTMFP::IsKeyFrame(pPayload->data(), pPayload->size()) ? WriterScheduler::KEYFRAME : WriterScheduler::INTERFRAME);
+	_messages.emplace_back(pMessage);
+	_band.wakeUp(); // sent by the scheduler of the connection at the next cycle
+	return true;
+}
+
 void RTMFPWriter::writeGroupConnect(const string& netGroup) {
 	string tmp(netGroup.c_str()); // To avoid memory sharing we use c_str() (copy-on-write implementation on linux)
 	createMessage().writer().packet.write8(GroupStream::GROUP_INIT).write16(0x2115).write(Util::UnformatHex(tmp)); // binary string
@@ -604,14 +653,14 @@ void RTMFPWriter::writeGroupPull(UInt64 index) {
 }
 
 void RTMFPWriter::writeRaw(const UInt8* data,UInt32 size) {
-	if(reliable || state()==OPENING) {
+	if(reliable || state()==OPENING || !_messages.empty()) { // copy if messages are waiting for the congestion window
 		createMessage().writer().packet.write(data,size);
 		return;
 	}
 	if(state()==CLOSED || _band.failed())
 		return;
 	_messages.emplace_back(new RTMFPMessageUnbuffered(data, size));
-	flush(false);
+	flush(false, false);
 }
 
 /*
@@ -0,0 +1,52 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "RTTEstimator.h"
+
+using namespace Mona;
+using namespace std;
+
+void RTTEstimator::update(UInt32 rtt) {
+	if (!rtt)
+		rtt = 1;
+
+	UInt32 srtt = _srtt, rttvar = _rttvar;
+	if (!srtt) { // first measure
+		srtt = rtt;
+		rttvar = rtt / 2;
+	} else {
+		UInt32 delta = (srtt > rtt) ? srtt - rtt : rtt - srtt;
+		rttvar = (3 * rttvar + delta) / 4;
+		srtt = (7 * srtt + rtt) / 8;
+		if (!srtt)
+			srtt = 1;
+	}
+	_rttvar = rttvar;
+	_srtt = srtt;
+
+	UInt32 rto = srtt + ((4 * rttvar > RTMFP_RTO_GRANULARITY) ? 4 * rttvar : RTMFP_RTO_GRANULARITY);
+	if (rto < RTMFP_RTO_MIN)
+		rto = RTMFP_RTO_MIN;
+	else if (rto > RTMFP_RTO_MAX)
+		rto = RTMFP_RTO_MAX;
+	_rto = rto;
+}
@@ -27,25 +27,48 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 using namespace Mona;
 using namespace std;
 
-SocketHandler::SocketHandler(Invoker* invoker, RTMFPSession* pSession) : _pInvoker(invoker), _acceptAll(false), _pMainSession(pSession) {
+// True if the packets sent by this thread are flushed by the caller (manage cycle or receiving thread of the batch socket),
+// otherwise it is an application call and the packets are sent at once
+static thread_local bool Batching(false);
+
+SocketHandler::SocketHandler(Invoker* invoker, RTMFPSession* pSession) : _pInvoker(invoker), _acceptAll(false), _pMainSession(pSession), _receiveCalls(0), _sendCalls(0), _pTimers(new TimerWheel()), _pFlushes(new TimerWheel()) {
 	onPacket = [this](PoolBuffer& pBuffer, const SocketAddress& address) {
-		if (_pMainSession->status < RTMFP::NEAR_CLOSED) {
-
-			lock_guard<mutex> lock(_mutexConnections);
-			auto itConnection = _mapAddress2Connection.find(address);
-			if (itConnection != _mapAddress2Connection.end())
-				itConnection->second->process(pBuffer);
-			else {
-				DEBUG("Input packet from a new address : ", address.toString());
-				_pDefaultConnection->setAddress(address);
-				_pDefaultConnection->process(pBuffer);
-			}
-		}
+		++_receiveCalls;
+		process(pBuffer, address);
+		endReception();
 	};
 	onError = [this](const Exception& ex) {
 		SocketAddress address;
 		DEBUG("Socket error : ", ex.error(), " from ", _pSocket->peerAddress(address).toString())
 	};
+	onBatchPacket = [this](PoolBuffer& pBuffer, const SocketAddress& address) {
+		Batching = true; // (flushed by onBatchEnd)
+		process(pBuffer, address);
+	};
+	onBatchEnd = [this]() {
+		endReception();
+		_pBatchSocket->flush();
+	};
+	onBatchError = [this](const Exception& ex) {
+		DEBUG("Batch socket error : ", ex.error())
+	};
+	_sweepTimer.onTimer = [this](Int64 now) {
+		// Delete old connections
+		bool deleted(false);
+		auto itConnection = _mapAddress2Connection.begin();
+		while (itConnection != _mapAddress2Connection.end()) {
+			if (itConnection->second->failed()) {
+				deleteConnection(itConnection);
+				_mapAddress2Connection.erase(itConnection++);
+				deleted = true;
+			} else
+				++itConnection;
+		}
+		if (deleted)
+			publishConnections();
+		_pTimers->set(_sweepTimer, now + RTMFP_SWEEP_DELAY);
+	};
+	_pTimers->set(_sweepTimer, _pTimers->now() + RTMFP_SWEEP_DELAY);
 
 	_pSocket.reset(new UDPSocket(_pInvoker->sockets));
 	_pSocket->OnError::subscribe(onError);
@@ -59,10 +82,19 @@ SocketHandler::~SocketHandler() {
 }
 
 void SocketHandler::close() {
-	lock_guard<mutex> lock(_mutexConnections);
+	// Stop the batch socket first (its receiving thread lock the connections)
+	if (_pBatchSocket) {
+		_pBatchSocket->close();
+		_pBatchSocket->OnPacket::unsubscribe(onBatchPacket);
+		_pBatchSocket->OnBatchEnd::unsubscribe(onBatchEnd);
+		_pBatchSocket->OnError::unsubscribe(onBatchError);
+	}
+
+	lock_guard<recursive_mutex> lock(_mutexConnections);
 	for (auto itConnection = _mapAddress2Connection.begin(); itConnection != _mapAddress2Connection.end(); itConnection++)
 		deleteConnection(itConnection);
 	_mapAddress2Connection.clear();
+	atomic_store(&_pConnectionsTable, shared_ptr<ConnectionsTable>());
 
 	// Unsubscribing to socket : we don't want to receive packets anymore
 	if (_pSocket) {
@@ -76,6 +108,120 @@ const PoolBuffers& SocketHandler::poolBuffers() {
 	return _pInvoker->poolBuffers;
 }
 
+bool SocketHandler::enableBatchedIO(Exception& ex) {
+	if (_pBatchSocket)
+		return true;
+
+	_pBatchSocket.reset(new BatchSocket(_pInvoker->poolBuffers));
+	_pBatchSocket->OnPacket::subscribe(onBatchPacket);
+	_pBatchSocket->OnBatchEnd::subscribe(onBatchEnd);
+	_pBatchSocket->OnError::subscribe(onBatchError);
+	if (!_pBatchSocket->open(ex)) {
+		_pBatchSocket->OnPacket::unsubscribe(onBatchPacket);
+		_pBatchSocket->OnBatchEnd::unsubscribe(onBatchEnd);
+		_pBatchSocket->OnError::unsubscribe(onBatchError);
+		_pBatchSocket.reset();
+		return false;
+	}
+	return true;
+}
+
+void SocketHandler::send(shared_ptr<RTMFPSender>& pSender, PoolThread*& pThread) {
+	if (_pBatchSocket) {
+		pSender->encode();
+		_pBatchSocket->send(pSender);
+		if (!Batching)
+			_pBatchSocket->flush(); // application call : no cycle will flush it
+		return;
+	}
+
+	++_sendCalls;
+	Exception ex;
+	pThread = _pSocket->send<RTMFPSender>(ex, pSender, pThread);
+	if (ex)
+		ERROR("RTMFP flush, ", ex.error());
+}
+
+void SocketHandler::flush() {
+	if (_pBatchSocket)
+		_pBatchSocket->flush();
+}
+
+UInt16 SocketHandler::port() {
+	return _pBatchSocket ? _pBatchSocket->port() : _pSocket->address().port();
+}
+
+void SocketHandler::updateConnections() {
+	lock_guard<recursive_mutex> lock(_mutexConnections);
+	publishConnections();
+}
+
+void SocketHandler::publishConnections() {
+	shared_ptr<ConnectionsTable> pTable(new ConnectionsTable((UInt32)_mapAddress2Connection.size()));
+	for (auto& itConnection : _mapAddress2Connection)
+		pTable->add(itConnection.second);
+	atomic_store(&_pConnectionsTable, pTable);
+}
+
+void SocketHandler::ioCounters(UInt64& receiveCalls, UInt64& packetsReceived, UInt64& sendCalls, UInt64& packetsSent) {
+	if (_pBatchSocket) {
+		receiveCalls = _pBatchSocket->receiveCalls;
+		packetsReceived = _pBatchSocket->packetsReceived;
+		sendCalls = _pBatchSocket->sendCalls;
+		packetsSent = _pBatchSocket->packetsSent;
+	}
+	else { // one system call by datagram
+		receiveCalls = packetsReceived = _receiveCalls;
+		sendCalls = packetsSent = _sendCalls;
+	}
+}
+
+void SocketHandler::process(PoolBuffer& pBuffer, const SocketAddress& address) {
+	if (_pMainSession->status >= RTMFP::NEAR_CLOSED)
+		return;
+
+	if (pBuffer->size() < RTMFP_MIN_PACKET_SIZE) {
+		ERROR("Invalid RTMFP packet from ", address.toString())
+		return;
+	}
+
+	// The near session id is unpacked once : to find the connection and to choose its decoder
+	BinaryReader reader(pBuffer.data(), pBuffer.size());
+	UInt32 nearId = RTMFP::Unpack(reader);
+	pBuffer->clip(reader.position());
+
+	// Find the connection without lock : by near session id first (if unique), then by address
+	shared_ptr<ConnectionsTable> pTable(atomic_load(&_pConnectionsTable));
+	const shared_ptr<RTMFPConnection>* ppConnection(NULL);
+	if (pTable) {
+		if (nearId)
+			ppConnection = pTable->find(nearId);
+		if (!ppConnection)
+			ppConnection = pTable->find(ConnectionsTable::Key(address));
+	}
+
+	// Only the lookup is lock free : the processing is serialized with the management (the handshakes, flows and writers are not thread safe)
+	lock_guard<recursive_mutex> lock(_mutexConnections);
+	_pTimers->update(Time::Now()); // clock of this packet for the flows and writers
+	if (ppConnection)
+		(*ppConnection)->process(pBuffer, nearId);
+	else {
+		DEBUG("Input packet from a new address : ", address.toString());
+		_pDefaultConnection->setAddress(address);
+		_pDefaultConnection->process(pBuffer, nearId);
+	}
+}
+
+void SocketHandler::endReception() {
+	if (_pMainSession->status >= RTMFP::NEAR_CLOSED)
+		return;
+
+	// Flush only the connections woken up by the packets received, their packets have been filled by all the writers meanwhile
+	// (the timers of the session are not raised here : the NetGroup and the peers are managed by the thread of the session)
+	lock_guard<recursive_mutex> lock(_mutexConnections);
+	_pFlushes->raise(Time::Now());
+}
+
 const string& SocketHandler::peerId() { 
 	return _pMainSession->peerId();
 }
@@ -95,7 +241,25 @@ bool SocketHandler::diffieHellman(DiffieHellman * &pDh) {
 void SocketHandler::addP2PConnection(const string& rawId, const string& peerId, const string& tag, const SocketAddress& hostAddress) {
 
 	//lock_guard<mutex> lock(_mutexConnections);
-	_mapTag2Peer.emplace(piecewise_construct, forward_as_tuple(tag), forward_as_tuple(rawId, peerId, hostAddress));
+	auto itPeer = _mapTag2Peer.emplace(piecewise_construct, forward_as_tuple(tag), forward_as_tuple(rawId, peerId, hostAddress)).first;
+
+	// Ask server to send p2p addresses (first attempt at the next cycle)
+	itPeer->second.timer.onTimer = [this, itPeer](Int64 now) {
+		WaitingPeer& peer = itPeer->second;
+		if (peer.attempt++ == 11) {
+			DEBUG("Connection to ", peer.peerId, " has reached 11 attempt without answer, removing the peer...")
+			_mapTag2Peer.erase(itPeer); // (deletes the timer)
+			return;
+		}
+
+		DEBUG("Sending new P2P handshake 30 to server (peerId : ", peer.peerId, ")")
+		_pDefaultConnection->setAddress(peer.hostAddress);
+		_pDefaultConnection->sendHandshake30(peer.rawId, itPeer->first);
+		peer.lastAttempt.update();
+		_pTimers->set(peer.timer, now + peer.attempt * 1500);
+	};
+	if (!itPeer->second.attempt)
+		_pTimers->set(itPeer->second.timer, _pTimers->now());
 }
 
 bool SocketHandler::onNewPeerId(const string& rawId, const string& peerId, const SocketAddress& address) {
@@ -112,13 +276,15 @@ void SocketHandler::onConnection(const SocketAddress& address, const string& nam
 }
 
 bool  SocketHandler::addConnection(shared_ptr<RTMFPConnection>& pConn, const SocketAddress& address, FlowManager* session, bool responder, bool p2p) {
-	//lock_guard<mutex> lock(_mutexConnections);
+	lock_guard<recursive_mutex> lock(_mutexConnections); // (can be called by the application thread)
 	auto itConnection = _mapAddress2Connection.lower_bound(address);
 	if (itConnection == _mapAddress2Connection.end() || itConnection->first != address) {
 		pConn = _mapAddress2Connection.emplace_hint(itConnection, piecewise_construct, forward_as_tuple(address), forward_as_tuple(new RTMFPConnection(address, this, session, responder, p2p)))->second;
 		pConn->OnIdBuilt::subscribe((OnIdBuilt&)*this);
 		if (session)
 			session->subscribe(pConn);
+		publishConnections();
+		pConn->wakeUp(); // first handshake at the next cycle
 		return true;
 	}
 	DEBUG("Connection already exists at address ", address.toString(), ", nothing done")
@@ -133,45 +299,13 @@ void SocketHandler::deleteConnection(const MAP_ADDRESS2CONNECTION::iterator& itC
 }
 
 void SocketHandler::manage() {
-	lock_guard<mutex> lock(_mutexConnections);
-
-	if (!_mapTag2Peer.empty()) {
-
-		// Ask server to send p2p addresses
-		auto itPeer = _mapTag2Peer.begin();
-		while (itPeer != _mapTag2Peer.end()) {
-			WaitingPeer& peer = itPeer->second;
-			if (!peer.attempt || peer.lastAttempt.isElapsed(peer.attempt * 1500)) {
-				if (peer.attempt++ == 11) {
-					DEBUG("Connection to ", peer.peerId, " has reached 11 attempt without answer, removing the peer...")
-					_mapTag2Peer.erase(itPeer++);
-					continue;
-				}
-
-				DEBUG("Sending new P2P handshake 30 to server (peerId : ", peer.peerId, ")")
-				_pDefaultConnection->setAddress(peer.hostAddress);
-				_pDefaultConnection->sendHandshake30(peer.rawId, itPeer->first);
-				peer.lastAttempt.update();
-			}
-			++itPeer;
-		}
-	}
-
-	// Manage all connections
-	for (auto itConnection : _mapAddress2Connection)
-		itConnection.second->manage();
-
-	// Delete old connections
-	auto itConnection2 = _mapAddress2Connection.begin();
-	while (itConnection2 != _mapAddress2Connection.end()) {
-		if (itConnection2->second->failed()) {
-			deleteConnection(itConnection2);
-			_mapAddress2Connection.erase(itConnection2++);
-		} else
-			++itConnection2;
-	}
+	lock_guard<recursive_mutex> lock(_mutexConnections);
 
-	_pDefaultConnection->manage();
+	// Raise the timers due with the clock of this cycle, the idle connections, writers, flows and peers are not visited
+	// (the packets are sent by flush() at the end of the cycle)
+	Batching = true;
+	_pTimers->raise(Time::Now());
+	Batching = false;
 }
 
 void SocketHandler::onP2PAddresses(const string& tagReceived, const PEER_LIST_ADDRESS_TYPE& addresses, const SocketAddress& hostAddress) {
@@ -192,6 +326,7 @@ void SocketHandler::onP2PAddresses(const string& tagReceived, const PEER_LIST_AD
 		_pDefaultConnection->sendHandshake30(it->second.rawId, it->first);
 		++it->second.attempt;
 		it->second.lastAttempt.update();
+		_pTimers->set(it->second.timer, _pTimers->now() + it->second.attempt * 1500);
 	}
 }
 
@@ -0,0 +1,181 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "TimerWheel.h"
+#include "Mona/Time.h"
+
+using namespace Mona;
+using namespace std;
+
+TimerWheel::TimerWheel() : _now(Time::Now()), _count(0) {
+	_tick = (UInt64)_now / RTMFP_TIMER_RESOLUTION;
+}
+
+TimerWheel::~TimerWheel() {
+	lock_guard<mutex> lock(_mutex);
+
+	// Timers still armed are just detached (they can be deleted after the wheel)
+	auto detach = [](List& list) {
+		Timer* pTimer = list.pFirst;
+		while (pTimer) {
+			Timer* pNext = pTimer->_pNext;
+			pTimer->_pWheel = NULL;
+			pTimer->_pList = NULL;
+			pTimer->_pPrevious = pTimer->_pNext = NULL;
+			pTimer->_deadline = 0;
+			pTimer = pNext;
+		}
+		list.pFirst = list.pLast = NULL;
+	};
+	for (UInt8 level = 0; level < RTMFP_TIMER_LEVELS; ++level) {
+		for (List& slot : _slots[level])
+			detach(slot);
+	}
+	detach(_due);
+}
+
+void TimerWheel::Push(List& list, Timer& timer) {
+	timer._pList = &list;
+	timer._pNext = NULL;
+	timer._pPrevious = list.pLast;
+	if (list.pLast)
+		list.pLast->_pNext = &timer;
+	else
+		list.pFirst = &timer;
+	list.pLast = &timer;
+}
+
+void TimerWheel::insert(Timer& timer, UInt64 minTick) {
+	if (timer._deadline <= _now) {
+		Push(_due, timer);
+		return;
+	}
+
+	UInt64 tick = ((UInt64)timer._deadline + RTMFP_TIMER_RESOLUTION - 1) / RTMFP_TIMER_RESOLUTION; // (never raised before its deadline)
+	if (tick < minTick)
+		tick = minTick;
+	UInt64 delta = tick - _tick;
+	if (delta >= (1ULL << (RTMFP_TIMER_SLOT_BITS * RTMFP_TIMER_LEVELS))) {
+		delta = (1ULL << (RTMFP_TIMER_SLOT_BITS * RTMFP_TIMER_LEVELS)) - 1;
+		tick = _tick + delta; // beyond the wheel : placed in its last slot, it will be placed again when reached
+	}
+
+	UInt8 level = 0;
+	while (level < RTMFP_TIMER_LEVELS - 1 && delta >= (1ULL << (RTMFP_TIMER_SLOT_BITS * (level + 1))))
+		++level;
+	Push(_slots[level][(tick >> (RTMFP_TIMER_SLOT_BITS * level)) & (RTMFP_TIMER_SLOTS - 1)], timer);
+}
+
+void TimerWheel::remove(Timer& timer) {
+	List& list(*timer._pList);
+	if (timer._pPrevious)
+		timer._pPrevious->_pNext = timer._pNext;
+	else
+		list.pFirst = timer._pNext;
+	if (timer._pNext)
+		timer._pNext->_pPrevious = timer._pPrevious;
+	else
+		list.pLast = timer._pPrevious;
+
+	timer._pWheel = NULL;
+	timer._pList = NULL;
+	timer._pPrevious = timer._pNext = NULL;
+	timer._deadline = 0;
+	--_count;
+}
+
+void TimerWheel::arm(Timer& timer, Int64 deadline) {
+	if (timer._pWheel)
+		remove(timer);
+	timer._pWheel = this;
+	timer._deadline = deadline;
+	insert(timer, _tick + 1); // the slot of the current tick has already been raised
+	++_count;
+}
+
+void TimerWheel::set(Timer& timer, Int64 deadline) {
+	lock_guard<mutex> lock(_mutex);
+	arm(timer, deadline);
+}
+
+void TimerWheel::anticipate(Timer& timer, Int64 deadline) {
+	lock_guard<mutex> lock(_mutex);
+	if (!timer._pWheel || timer._deadline > deadline)
+		arm(timer, deadline);
+}
+
+void TimerWheel::cancel(Timer& timer) {
+	lock_guard<mutex> lock(_mutex);
+	if (timer._pWheel)
+		remove(timer);
+}
+
+void TimerWheel::cascade(List& slot) {
+	Timer* pTimer = slot.pFirst;
+	slot.pFirst = slot.pLast = NULL;
+	while (pTimer) {
+		Timer* pNext = pTimer->_pNext;
+		insert(*pTimer, _tick);
+		pTimer = pNext;
+	}
+}
+
+UInt32 TimerWheel::raise(Int64 now) {
+	unique_lock<mutex> lock(_mutex);
+
+	_now = now;
+	UInt64 target = (UInt64)now / RTMFP_TIMER_RESOLUTION;
+	if (!_count && target > _tick)
+		_tick = target; // nothing to move
+	while (_tick < target) {
+		++_tick;
+
+		// Move the slots of the upper levels reached to the lower levels
+		for (UInt8 level = 1; level < RTMFP_TIMER_LEVELS && !(_tick & ((1ULL << (RTMFP_TIMER_SLOT_BITS * level)) - 1)); ++level)
+			cascade(_slots[level][(_tick >> (RTMFP_TIMER_SLOT_BITS * level)) & (RTMFP_TIMER_SLOTS - 1)]);
+
+		// The timers of the first level slot are due
+		List& slot(_slots[0][_tick & (RTMFP_TIMER_SLOTS - 1)]);
+		Timer* pTimer = slot.pFirst;
+		slot.pFirst = slot.pLast = NULL;
+		while (pTimer) {
+			Timer* pNext = pTimer->_pNext;
+			Push(_due, *pTimer);
+			pTimer = pNext;
+		}
+	}
+
+	// Raise the timers due (a callback can arm timers again or delete its own timer)
+	UInt32 raised(0);
+	while (_due.pFirst) {
+		Timer& timer(*_due.pFirst);
+		remove(timer);
+		if (!timer.onTimer)
+			continue;
+		Timer::OnTimer onTimer(timer.onTimer);
+		lock.unlock();
+		onTimer(now);
+		lock.lock();
+		++raised;
+	}
+	return raised;
+}
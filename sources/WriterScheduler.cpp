@@ -0,0 +1,159 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "WriterScheduler.h"
+#include "RTMFPWriter.h"
+#include "BandWriter.h"
+#include <algorithm>
+
+using namespace Mona;
+using namespace std;
+
+// Credit of each class at each round (in quantums)
+static const Int32 Weights[WriterScheduler::COUNT] = { 16, 8, 4, 2, 1 };
+
+WriterScheduler::WriterScheduler() : _backlog(COUNT) {
+	for (UInt8 i = 0; i < COUNT; ++i) {
+		_deficits[i] = 0;
+		_lastWriters[i] = 0;
+	}
+}
+
+bool WriterScheduler::canSend(UInt8 priority, CongestionController& congestion) {
+	if (priority > _backlog)
+		return false; // messages of a higher class are waiting
+	if (congestion.canSend())
+		return true;
+	_backlog = priority; // this message now waits for the scheduler
+	return false;
+}
+
+void WriterScheduler::push(RTMFPWriter& writer) {
+	UInt8 priority = writer.nextPriority();
+	if (priority < COUNT)
+		_queues[priority].push_back(&writer);
+}
+
+void WriterScheduler::requeue(RTMFPWriter& writer, UInt8 priority, size_t index, size_t& cursor) {
+	UInt8 next = writer.nextPriority();
+	if (next == priority)
+		return;
+	vector<RTMFPWriter*>& queue(_queues[priority]);
+	queue.erase(queue.begin() + index);
+	if (index < cursor)
+		--cursor;
+	if (next < COUNT)
+		_queues[next].push_back(&writer);
+}
+
+bool WriterScheduler::pack(UInt32 available, size_t* cursors) {
+	UInt8 priority(COUNT);
+	size_t index(0);
+	UInt32 packedSize(0);
+	for (UInt8 i = 0; i < COUNT; ++i) {
+		vector<RTMFPWriter*>& queue(_queues[i]);
+		for (size_t j = 0; j < queue.size(); ++j) {
+			UInt32 size = queue[j]->packedSize();
+			if (size <= available && size > packedSize) {
+				priority = i;
+				index = j;
+				packedSize = size;
+			}
+		}
+	}
+	if (priority == COUNT)
+		return false;
+	RTMFPWriter& writer(*_queues[priority][index]);
+	_deficits[priority] -= writer.sendMessage(); // (charged to its class, the round robin stays fair)
+	requeue(writer, priority, index, cursors[priority]);
+	return true;
+}
+
+void WriterScheduler::flush(map<UInt64, shared_ptr<RTMFPWriter>>& writers, BandWriter& band) {
+	CongestionController& congestion(band.congestion());
+	for (vector<RTMFPWriter*>& queue : _queues)
+		queue.clear();
+	for (auto& it : writers)
+		push(*it.second);
+
+	// Begin each class with the writer following the last one served
+	size_t cursors[COUNT];
+	for (UInt8 i = 0; i < COUNT; ++i) {
+		vector<RTMFPWriter*>& queue(_queues[i]);
+		UInt64 lastWriter = _lastWriters[i];
+		rotate(queue.begin(), find_if(queue.begin(), queue.end(), [lastWriter](RTMFPWriter* pWriter) { return pWriter->id > lastWriter; }), queue.end());
+		cursors[i] = 0;
+	}
+
+	while (congestion.canSend()) {
+		// Find the highest class having messages and credit
+		UInt8 priority = COUNT;
+		bool waiting = false;
+		for (UInt8 i = 0; i < COUNT; ++i) {
+			if (_queues[i].empty())
+				continue;
+			waiting = true;
+			if (_deficits[i] > 0) {
+				priority = i;
+				break;
+			}
+		}
+		if (!waiting)
+			break;
+		if (priority == COUNT) {
+			// New round : credit the classes waiting
+			for (UInt8 i = 0; i < COUNT; ++i) {
+				if (!_queues[i].empty())
+					_deficits[i] += Weights[i] * RTMFP_SCHEDULER_QUANTUM;
+			}
+			continue;
+		}
+
+		// Send one message of the current writer of the class
+		vector<RTMFPWriter*>& queue(_queues[priority]);
+		size_t& cursor(cursors[priority]);
+		if (cursor >= queue.size())
+			cursor = 0;
+		RTMFPWriter& writer(*queue[cursor]);
+
+		// Packing : the message would be fragmented in the end of the current packet, complete it first with a whole message
+		UInt32 available(band.availableToWrite());
+		if (available < (RTMFP_MAX_PACKET_SIZE - RTMFP_HEADER_SIZE) && writer.packedSize() > available && pack(available, cursors))
+			continue;
+
+		_deficits[priority] -= writer.sendMessage();
+		_lastWriters[priority] = writer.id;
+
+		if (writer.nextPriority() == priority)
+			++cursor; // next writer of the class
+		else
+			requeue(writer, priority, cursor, cursor);
+	}
+
+	// Classes without message lose their credit, the highest class still waiting blocks the direct sending of the lower ones
+	_backlog = COUNT;
+	for (UInt8 i = COUNT; i-- > 0;) {
+		if (_queues[i].empty())
+			_deficits[i] = 0;
+		else
+			_backlog = i;
+	}
+}
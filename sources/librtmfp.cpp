@@ -52,6 +52,11 @@ void RTMFP_Init(RTMFPConfig* config, RTMFPGroupConfig* groupConfig) {
 	}
 
 	memset(config, 0, sizeof(RTMFPConfig));
+	config->ackDelay = RTMFP_ACK_DELAY;
+	config->ackPackets = RTMFP_ACK_PACKETS;
+	config->audioLifetime = RTMFP_AUDIO_LIFETIME;
+	config->keyFrameLifetime = RTMFP_KEYFRAME_LIFETIME;
+	config->interFrameLifetime = RTMFP_INTERFRAME_LIFETIME;
 
 	if (!groupConfig)
 		return; // ignore groupConfig if not set
@@ -85,8 +90,11 @@ unsigned int RTMFP_Connect(const char* url, RTMFPConfig* parameters) {
 
 	Exception ex;
 	shared_ptr<RTMFPSession> pConn(new RTMFPSession(GlobalInvoker.get(), parameters->pOnSocketError, parameters->pOnStatusEvent, parameters->pOnMedia));
+	// Configured before being managed by the thread of its shard
+	pConn->setAckPolicy(parameters->ackDelay, parameters->ackPackets);
+	pConn->setMediaLifetimes(parameters->audioLifetime, parameters->keyFrameLifetime, parameters->interFrameLifetime);
 	unsigned int index = GlobalInvoker->addConnection(pConn);
-	if (!pConn->connect(ex, url, host.c_str())) {
+	if (!pConn->connect(ex, url, host.c_str(), parameters->isBatchedIO != 0)) {
 		ERROR("Error in connect : ", ex.error())
 		GlobalInvoker->removeConnection(index);
 		return 0;
@@ -241,10 +249,9 @@ int RTMFP_Read(const char* peerId, unsigned int RTMFPcontext,char *buf,unsigned
 				size -= nbRead;
 				total += nbRead;
 			}
-			else { // Nothing read, wait for data
-				while (!pConn->dataAvailable) {
-					DEBUG("Nothing available, sleeping...")
-					pConn->readSignal.wait(100);
+			else { // Nothing read, wait for data (woken up as soon as data arrives, the timeout is used to check the interrupt callback)
+				DEBUG("Nothing available, sleeping...")
+				while (!pConn->readSignal.wait(100)) {
 					if (GlobalInterruptCb(GlobalInterruptArg) == 1)
 						return 0;
 				}
@@ -256,6 +263,53 @@ int RTMFP_Read(const char* peerId, unsigned int RTMFPcontext,char *buf,unsigned
 	return -1;
 }
 
+int RTMFP_ReadFrames(const char* peerId, unsigned int RTMFPcontext, RTMFPFrame* frames, unsigned int count) {
+	if (!GlobalInvoker) {
+		ERROR("Invoker is not ready, you must establish the connection first")
+		return -1;
+	}
+	if (!frames && count) {
+		ERROR("frames parameter must be not null")
+		return -1;
+	}
+
+	shared_ptr<RTMFPSession> pConn;
+	GlobalInvoker->getConnection(RTMFPcontext, pConn);
+	if (pConn) {
+		int nbFrames = 0;
+		while (count && GlobalInterruptCb(GlobalInterruptArg) != 1) {
+			if (!pConn->readFrames(peerId, frames, count, nbFrames)) {
+				WARN("Connection is not established, cannot read frames")
+				return -1;
+			}
+			if (nbFrames > 0)
+				break;
+
+			// Nothing read, wait for data (woken up as soon as data arrives, the timeout is used to check the interrupt callback)
+			DEBUG("Nothing available, sleeping...")
+			while (!pConn->readSignal.wait(100)) {
+				if (GlobalInterruptCb(GlobalInterruptArg) == 1)
+					return 0;
+			}
+		}
+		return nbFrames;
+	}
+
+	return -1;
+}
+
+void RTMFP_ReleaseFrames(const char* peerId, unsigned int RTMFPcontext) {
+	if (!GlobalInvoker) {
+		ERROR("Invoker is not ready, you must establish the connection first")
+		return;
+	}
+
+	shared_ptr<RTMFPSession> pConn;
+	GlobalInvoker->getConnection(RTMFPcontext, pConn);
+	if (pConn)
+		pConn->releaseFrames(peerId);
+}
+
 int RTMFP_Write(unsigned int RTMFPcontext,const char *buf,int size) {
 	if (!GlobalInvoker) {
 		ERROR("Invoker is not ready, you must establish the connection first")
@@ -274,6 +328,53 @@ int RTMFP_Write(unsigned int RTMFPcontext,const char *buf,int size) {
 	return -1;
 }
 
+int RTMFP_WriteFrame(unsigned int RTMFPcontext, unsigned char type, unsigned int time, const char* data, unsigned int size) {
+	RTMFPFrame frame = { type, time, data, size };
+	return RTMFP_WriteFrames(RTMFPcontext, &frame, 1);
+}
+
+int RTMFP_WriteFrames(unsigned int RTMFPcontext, const RTMFPFrame* frames, unsigned int count) {
+	if (!GlobalInvoker) {
+		ERROR("Invoker is not ready, you must establish the connection first")
+		return -1;
+	}
+	if (!frames && count) {
+		ERROR("frames parameter must be not null")
+		return -1;
+	}
+
+	shared_ptr<RTMFPSession> pConn;
+	GlobalInvoker->getConnection(RTMFPcontext, pConn);
+	if (pConn) {
+		int queued = 0;
+		if (!pConn->writeFrames(frames, count, queued))
+			return -1;
+		return queued;
+	}
+
+	return -1;
+}
+
+int RTMFP_GetStatistics(unsigned int RTMFPcontext, RTMFPStatistics* statistics) {
+	if (!GlobalInvoker) {
+		ERROR("Invoker is not ready, you must establish the connection first")
+		return 0;
+	}
+	if (!statistics) {
+		ERROR("statistics parameter must be not null")
+		return 0;
+	}
+
+	shared_ptr<RTMFPSession> pConn;
+	GlobalInvoker->getConnection(RTMFPcontext, pConn);
+	if (!pConn)
+		return 0;
+
+	memset(statistics, 0, sizeof(RTMFPStatistics));
+	pConn->getStatistics(*statistics);
+	return 1;
+}
+
 unsigned int RTMFP_CallFunction(unsigned int RTMFPcontext, const char* function, int nbArgs, const char** args, const char* peerId) {
 	if (!GlobalInvoker) {
 		ERROR("Invoker is not ready, you must establish the connection first")
@@ -288,6 +389,14 @@ unsigned int RTMFP_CallFunction(unsigned int RTMFPcontext, const char* function,
 	return pConn->callFunction(function, nbArgs, args, peerId);
 }
 
+void RTMFP_SetManagerThreads(unsigned int threads) {
+	if (!GlobalInvoker) {
+		ERROR("RTMFP_Init() has not been called, please call it first")
+		return;
+	}
+	GlobalInvoker->setManagerThreads(threads > MAX_CONNECTIONS_SHARDS ? MAX_CONNECTIONS_SHARDS : (UInt16)threads);
+}
+
 void RTMFP_LogSetCallback(void(* onLog)(unsigned int, int, const char*, long, const char*)) {
 	if (!GlobalInvoker)
 		ERROR("RTMFP_Init() has not been called, please call it first")